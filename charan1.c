@@ -1,967 +1,5276 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdbool.h>
-
-#define ORDER 6
-#define MAX_TRANSACTIONS 1000
-#define MAX_BUYERS 100
-#define MAX_SELLERS 100
-#define ENERGY_THRESHOLD 300.0  
-
-// ---------------------------- Structures ----------------------------
-
-typedef struct Transaction {
-    int transaction_id;
-    int buyer_id;
-    int seller_id;
-    float energy_kwh;
-    float price_per_kwh;
-    float total_price;
-    char datetime[20]; // Format: "YYYY-MM-DD HH:MM"
-    float rate_below_300; 
-    float rate_above_300;  
-} Transaction;
-
-typedef struct node {
-    void **pointers;
-    int *keys;
-    struct node *parent;
-    bool is_leaf;
-    int num_keys;
-    struct node *next;
-} node;
-
-typedef struct SellerKey {
-    int seller_id;
-    float rate_below_300;
-    float rate_above_300;
-    int regular_buyers[MAX_BUYERS];
-    int regular_buyer_count;
-    node *transaction_tree;
-    int transaction_count;
-} SellerKey;
-
-typedef struct BuyerKey {
-    int buyer_id;
-    float total_energy_purchased;
-    node *transaction_tree;
-    int transaction_count;
-} BuyerKey;
-// ---------------------------- Globals ----------------------------
-
-
-node *seller_tree = NULL;
-node *buyer_tree = NULL;
-node *global_transaction_tree=NULL;
-Transaction *all_transactions[MAX_TRANSACTIONS];
-int transaction_index=0;
-
-// ---------------------------- B+ Tree Helpers ----------------------------
-
-node *create_node(bool is_leaf) {
-    node *new_node=(node *)malloc(sizeof(node));
-    if (!new_node) {
-        printf("Memory allocation failed for node.\n");
-        exit(1);
-    }
-    new_node->pointers=(void **)malloc((ORDER + 1) * sizeof(void *));
-    new_node->keys=(int *)malloc((ORDER - 1) * sizeof(int));
-
-    if (!new_node->pointers || !new_node->keys) {
-        printf("Memory allocation failed for node components.\n");
-        exit(1);
-    }
-
-    new_node->parent=NULL;
-    new_node->is_leaf=is_leaf;
-    new_node->num_keys=0;
-    new_node->next=NULL;
-
-    return new_node;
-}
-
-void split_child(node *x, int index) {
-    node *y = (node *)x->pointers[index];
-    node *z = create_node(y->is_leaf);
-    z->parent = x;
-
-    int mid = ORDER / 2;
-    int j = 0;
-
-    if (y->is_leaf) {
-        for (int i = mid; i < y->num_keys; i++) {
-            z->keys[j] = y->keys[i];
-            z->pointers[j] = y->pointers[i];
-            j++;
-        }
-        z->num_keys = y->num_keys - mid;
-        y->num_keys = mid;
-
-        z->next = y->next;
-        y->next = z;
-
-        for (int i = x->num_keys + 1; i > index + 1; i--) {
-            x->pointers[i] = x->pointers[i - 1];
-        }
-        for (int i = x->num_keys; i > index; i--) {
-            x->keys[i] = x->keys[i - 1];
-        }
-
-        x->keys[index] = z->keys[0];  // Copy first key from z
-        x->pointers[index + 1] = z;
-    } else {
-        for (int i = mid + 1; i < y->num_keys; i++) {
-            z->keys[j] = y->keys[i];
-            z->pointers[j] = y->pointers[i];
-            j++;
-        }
-        z->pointers[j] = y->pointers[y->num_keys];
-
-        z->num_keys = y->num_keys - mid - 1;
-        y->num_keys = mid;
-
-        for (int i = x->num_keys + 1; i > index + 1; i--) {
-            x->pointers[i] = x->pointers[i - 1];
-        }
-        for (int i = x->num_keys; i > index; i--) {
-            x->keys[i] = x->keys[i - 1];
-        }
-
-        x->keys[index] = y->keys[mid];
-        x->pointers[index + 1] = z;
-    }
-
-    x->num_keys++;
-}
-
-void insert_non_full(node *x, Transaction *t) {
-    int i = x->num_keys - 1;
-
-    if (x->is_leaf == true) {
-        while (i >= 0 && t->transaction_id < x->keys[i]) {
-            x->keys[i + 1] = x->keys[i];
-            x->pointers[i + 1] = x->pointers[i];
-            i = i - 1;
-        }
-
-        x->keys[i + 1] = t->transaction_id;
-        x->pointers[i + 1] = t;
-        x->num_keys = x->num_keys + 1;
-    } else {
-        while (i >= 0 && t->transaction_id < x->keys[i]) {
-            i = i - 1;
-        }
-        i = i + 1;
-
-        node *child = (node *)x->pointers[i];
-        if (child->num_keys == ORDER - 1) {
-            split_child(x, i);
-            if (t->transaction_id > x->keys[i]) {
-                i = i + 1;
-            }
-        }
-
-        insert_non_full((node *)x->pointers[i], t);
-    }
-}
-
-node *insert_transaction(node *root, Transaction *t) {
-    if (root == NULL) {
-        root = create_node(true);
-    }
-
-    if (root->num_keys == ORDER - 1) {
-        node *new_root = create_node(false);
-        new_root->pointers[0] = root;
-        root->parent = new_root;
-        split_child(new_root, 0);
-        insert_non_full(new_root, t);
-        return new_root;
-    } else {
-        insert_non_full(root, t);
-    }
-
-    return root;
-}
-
-node *find_leftmost_leaf(node *root) {
-    while (root != NULL && root->is_leaf == false) {
-        root = root->pointers[0];
-    }
-    return root;
-}
-
-// ---------------------------- Core Functions ----------------------------
-
-
-
-
-
-
-// Leap year checker
-bool is_leap_year(int year) {
-    return (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
-}
-
-// Helper to extract and convert a number safely from a string range
-int extract_int(const char *str, int start, int len) {
-    int value = 0;
-    for (int i = 0; i < len; i++) {
-        
-        value = value * 10 + (str[start + i] - '0');
-    }
-    return value;
-}
-
-// Main validation function
-bool validate_datetime(const char *datetime) {
-    if (strlen(datetime) != 16) return false;
-    if (datetime[4] != '-' || datetime[7] != '-' || datetime[10] != ' ' || datetime[13] != ':') 
-        return false;
-
-    int year   = extract_int(datetime, 0, 4);
-    int month  = extract_int(datetime, 5, 2);
-    int day    = extract_int(datetime, 8, 2);
-    int hour   = extract_int(datetime, 11, 2);
-    int minute = extract_int(datetime, 14, 2);
-
-    if (year < 1) return false;                    // Year must be positive
-    if (month < 1 || month > 12) return false;
-    if (hour < 0 || hour > 23) return false;
-    if (minute < 0 || minute > 59) return false;
-
-    int days_in_month[] = { 31,28,31,30,31,30,31,31,30,31,30,31 };
-    if (is_leap_year(year)) days_in_month[1] = 29;
-
-    if (day < 1 || day > days_in_month[month - 1]) return false;
-
-    return true;
-}
-
-SellerKey* get_or_create_seller(int seller_id, float rate_below_300, float rate_above_300) {
-    // Search in seller_tree
-    node *leaf = find_leftmost_leaf(seller_tree);
-    while (leaf) {
-        for (int i = 0; i < leaf->num_keys; i++) {
-            SellerKey *s = (SellerKey *)leaf->pointers[i];
-            if (s->seller_id == seller_id) {
-                // Update rates if provided
-                if (rate_below_300 > 0) s->rate_below_300 = rate_below_300;
-                if (rate_above_300 > 0) s->rate_above_300 = rate_above_300;
-                return s;
-            }
-        }
-        leaf = leaf->next;
-    }
-
-    // Seller not found - create new
-    SellerKey *new_seller = (SellerKey *)malloc(sizeof(SellerKey));
-    new_seller->seller_id = seller_id;
-    new_seller->rate_below_300 = rate_below_300;
-    new_seller->rate_above_300 = rate_above_300;
-    new_seller->transaction_tree = NULL;
-    new_seller->transaction_count = 0;
-    new_seller->regular_buyer_count = 0;
-
-    // Insert into seller_tree using seller_id as key
-    seller_tree = insert_transaction(seller_tree, (Transaction *)new_seller);
-    return new_seller;
-}
-BuyerKey* get_or_create_buyer(int buyer_id) {
-    // Search in buyer_tree
-    node *leaf = find_leftmost_leaf(buyer_tree);
-    while (leaf) {
-        for (int i = 0; i < leaf->num_keys; i++) {
-            BuyerKey *b = (BuyerKey *)leaf->pointers[i];
-            if (b->buyer_id == buyer_id) {
-                return b;
-            }
-        }
-        leaf = leaf->next;
-    }
-
-    // Buyer not found - create new
-    BuyerKey *new_buyer = (BuyerKey *)malloc(sizeof(BuyerKey));
-    new_buyer->buyer_id = buyer_id;
-    new_buyer->total_energy_purchased = 0;
-    new_buyer->transaction_tree = NULL;
-    new_buyer->transaction_count = 0;
-
-    // Insert into buyer_tree using buyer_id as key
-    buyer_tree = insert_transaction(buyer_tree, (Transaction *)new_buyer);
-    return new_buyer;
-}
-float calculate_price(SellerKey *s, float energy_kwh, int buyer_id) {
-    float total_price = 0.0;
-    
-    // Check if buyer is a regular customer
-    bool is_regular = false;
-    for (int i = 0; i < s->regular_buyer_count; i++) {
-        if (s->regular_buyers[i] == buyer_id) {
-            is_regular = true;
-            break;
-        }
-    }
-    
-    // Calculate price based on tiered rates
-    if (energy_kwh <= ENERGY_THRESHOLD) {
-        total_price = energy_kwh * s->rate_below_300;
-    } else {
-        total_price = ENERGY_THRESHOLD * s->rate_below_300;
-        total_price += (energy_kwh - ENERGY_THRESHOLD) * s->rate_above_300;
-    }
-    
-    // Apply 5% discount for regular customers
-    if (is_regular) {
-        total_price *= 0.95;
-    }
-    
-    return total_price;
-}
-bool add_transaction(Transaction *t) {
-    // ... existing duplicate check code ...
-    bool isadded = true;
-    node *leaf = find_leftmost_leaf(global_transaction_tree);
-    while (leaf) {
-        for (int i = 0; i < leaf->num_keys; i++) {
-            Transaction *t1 = (Transaction *)leaf->pointers[i];
-            if(t1->transaction_id==t->transaction_id) {
-                printf("Transaction already exists. Try again!");
-                isadded = false;
-                return isadded;
-            }
-        }
-        leaf = leaf->next;
-    }
-    all_transactions[transaction_index++] = t;
-    global_transaction_tree = insert_transaction(global_transaction_tree, t);
-
-    // Use the new B+ tree versions
-    SellerKey *s = get_or_create_seller(t->seller_id, t->rate_below_300, t->rate_above_300);
-    s->transaction_tree = insert_transaction(s->transaction_tree, t);
-    s->transaction_count++;
-
-    BuyerKey *b = get_or_create_buyer(t->buyer_id);
-    b->transaction_tree = insert_transaction(b->transaction_tree, t);
-    b->total_energy_purchased += t->energy_kwh;
-    b->transaction_count++;
-
-    if (b->transaction_count > 5) {
-        bool already_added = false;
-        for (int j = 0; j < s->regular_buyer_count; j++) {
-            if (s->regular_buyers[j] == b->buyer_id) {
-                already_added = true;
-                break;
-            }
-        }
-        if (!already_added && s->regular_buyer_count < MAX_BUYERS) {
-            s->regular_buyers[s->regular_buyer_count++] = b->buyer_id;
-            printf("Buyer %d is now a regular customer of Seller %d!\n", b->buyer_id, s->seller_id);
-        }
-    }
-    return true;
-}
-
-void display_all_transactions() {
-    printf("\nAll Transactions:\n");
-    printf("%-5s %-8s %-8s %-12s %-12s %-12s %-20s\n", 
-           "ID", "Buyer", "Seller", "Energy(kWh)", "Price/kWh", "Total($)", "Time");
-    printf("-----------------------------------------------------------------------\n");
-    
-    node *leaf = find_leftmost_leaf(global_transaction_tree);
-    while (leaf) {
-        for (int i = 0; i < leaf->num_keys; i++) {
-            Transaction *t = (Transaction *)leaf->pointers[i];
-            printf("%-5d %-8d %-8d %-12.2f %-12.2f %-12.2f %s\n",
-                   t->transaction_id, t->buyer_id, t->seller_id, 
-                   t->energy_kwh, t->price_per_kwh, t->total_price, t->datetime);
-        }
-        leaf = leaf->next;
-    }
-}
-
-void transactions_by_seller() {
-    printf("\nTransactions by Seller:\n");
-    
-    node *seller_leaf = find_leftmost_leaf(seller_tree);
-    while (seller_leaf) {
-        for (int i = 0; i < seller_leaf->num_keys; i++) {
-            SellerKey *s = (SellerKey *)seller_leaf->pointers[i];
-            
-            printf("\nSeller %d:\n", s->seller_id);
-            printf("Rates: %.2f$/kWh (≤300kWh), %.2f$/kWh (>300kWh)\n", 
-                   s->rate_below_300, s->rate_above_300);
-            
-            // Print transactions for this seller
-            node *trans_leaf = find_leftmost_leaf(s->transaction_tree);
-            while (trans_leaf) {
-                for (int j = 0; j < trans_leaf->num_keys; j++) {
-                    Transaction *t = (Transaction *)trans_leaf->pointers[j];
-                    printf("Transaction ID: %d, Buyer: %d, Energy: %.2f kWh\n",
-                           t->transaction_id, t->buyer_id, t->energy_kwh);
-                }
-                trans_leaf = trans_leaf->next;
-            }
-        }
-        seller_leaf = seller_leaf->next;
-    }
-}
-
-void transactions_by_buyer() {
-    printf("\nTransactions by Buyer:\n");
-    
-    // Start at the leftmost leaf of the buyer tree
-    node *buyer_leaf = find_leftmost_leaf(buyer_tree);
-    
-    while (buyer_leaf != NULL) {
-        // Iterate through all keys in this leaf node
-        for (int i = 0; i < buyer_leaf->num_keys; i++) {
-            BuyerKey *b = (BuyerKey *)buyer_leaf->pointers[i];
-            
-            printf("\nBuyer %d (Total Energy: %.2f kWh, Transactions: %d):\n", 
-                   b->buyer_id, b->total_energy_purchased, b->transaction_count);
-            
-            printf("%-5s %-8s %-12s %-12s %-12s %-20s\n", 
-                   "ID", "Seller", "Energy(kWh)", "Price/kWh", "Total($)", "Time");
-            printf("-----------------------------------------------------------------\n");
-            
-            // Now display all transactions for this buyer
-            node *trans_leaf = find_leftmost_leaf(b->transaction_tree);
-            while (trans_leaf != NULL) {
-                for (int j = 0; j < trans_leaf->num_keys; j++) {
-                    Transaction *t = (Transaction *)trans_leaf->pointers[j];
-                    
-                    printf("%-5d %-8d %-12.2f %-12.2f %-12.2f %s\n", 
-                           t->transaction_id, t->seller_id, t->energy_kwh, 
-                           t->price_per_kwh, t->total_price, t->datetime);
-                }
-                trans_leaf = trans_leaf->next;
-            }
-        }
-        buyer_leaf = buyer_leaf->next;
-    }
-}
-
-void total_revenue_by_seller() {
-    printf("\nTotal Revenue by Seller:\n");
-    printf("%-8s %-15s %-15s %-15s\n", 
-           "Seller", "Revenue($)", "Energy(kWh)", "Transactions");
-    printf("--------------------------------------------------\n");
-    
-    // Start at the leftmost leaf of the seller tree
-    node *seller_leaf = find_leftmost_leaf(seller_tree);
-    
-    while (seller_leaf != NULL) {
-        // Iterate through all seller keys in this leaf node
-        for (int i = 0; i < seller_leaf->num_keys; i++) {
-            SellerKey *s = (SellerKey *)seller_leaf->pointers[i];
-            float revenue = 0.0;
-            float total_energy = 0.0;
-            
-            // Calculate revenue and energy by traversing the seller's transaction tree
-            node *trans_leaf = find_leftmost_leaf(s->transaction_tree);
-            while (trans_leaf != NULL) {
-                for (int j = 0; j < trans_leaf->num_keys; j++) {
-                    Transaction *t = (Transaction *)trans_leaf->pointers[j];
-                    revenue += t->total_price;
-                    total_energy += t->energy_kwh;
-                }
-                trans_leaf = trans_leaf->next;
-            }
-            
-            printf("%-8d %-15.2f %-15.2f %-15d\n", 
-                   s->seller_id, revenue, total_energy, s->transaction_count);
-        }
-        seller_leaf = seller_leaf->next;
-    }
-}
-void energy_range_transactions(float min_kwh, float max_kwh) {
-    printf("\nTransactions in Energy Range %.2f - %.2f kWh:\n", min_kwh, max_kwh);
-    printf("%-5s %-8s %-8s %-12s %-12s %-12s\n", 
-           "ID", "Buyer", "Seller", "Energy(kWh)", "Price/kWh", "Total($)");
-    printf("--------------------------------------------------------------\n");
-    
-    node *leaf = find_leftmost_leaf(global_transaction_tree);
-    while (leaf) {
-        for (int i = 0; i < leaf->num_keys; i++) {
-            Transaction *t = (Transaction *)leaf->pointers[i];
-            if (t->energy_kwh >= min_kwh && t->energy_kwh <= max_kwh) {
-                printf("%-5d %-8d %-8d %-12.2f %-12.2f %-12.2f\n", 
-                       t->transaction_id, t->buyer_id, t->seller_id, 
-                       t->energy_kwh, t->price_per_kwh, t->total_price);
-            }
-        }
-        leaf = leaf->next;
-    }
-}
-
-void sort_buyers_by_energy() {
-    printf("\nBuyers Sorted by Total Energy Purchased:\n");
-    printf("%-8s %-15s %-15s\n", "Buyer", "Energy(kWh)", "Transactions");
-    printf("----------------------------------------\n");
-
-    // First, collect all buyers into an array for sorting
-    BuyerKey *buyers[MAX_BUYERS];
-    int buyer_count = 0;
-
-    // Traverse the B+ tree to collect buyers
-    node *leaf = find_leftmost_leaf(buyer_tree);
-    while (leaf != NULL && buyer_count < MAX_BUYERS) {
-        for (int i = 0; i < leaf->num_keys; i++) {
-            buyers[buyer_count++] = (BuyerKey *)leaf->pointers[i];
-            if (buyer_count >= MAX_BUYERS) break;
-        }
-        leaf = leaf->next;
-    }
-
-    // Bubble sort
-    for (int i = 0; i < buyer_count - 1; i++) {
-        for (int j = 0; j < buyer_count - i - 1; j++) {
-            if (buyers[j]->total_energy_purchased > buyers[j+1]->total_energy_purchased) {
-                BuyerKey *temp = buyers[j];
-                buyers[j] = buyers[j+1];
-                buyers[j+1] = temp;
-            }
-        }
-    }
-
-    // Display sorted results
-    for (int i = 0; i < buyer_count; i++) {
-        printf("%-8d %-15.2f %-15d\n", 
-               buyers[i]->buyer_id, 
-               buyers[i]->total_energy_purchased,
-               buyers[i]->transaction_count);
-    }
-}
-
-void sort_pairs_by_transaction_count() {
-    printf("\nBuyer/Seller Pairs by Number of Transactions:\n");
-    printf("%-8s %-8s %-15s\n", "Buyer", "Seller", "Transactions");
-    printf("--------------------------------\n");
-
-    // Structure to hold buyer-seller pairs
-    typedef struct {
-        int buyer_id;
-        int seller_id;
-        int transaction_count;
-    } Pair;
-    
-    Pair pairs[MAX_BUYERS * MAX_SELLERS];
-    int pair_count = 0;
-
-    // Traverse buyer tree
-    node *buyer_leaf = find_leftmost_leaf(buyer_tree);
-    while (buyer_leaf != NULL && pair_count < MAX_BUYERS * MAX_SELLERS) {
-        for (int b = 0; b < buyer_leaf->num_keys; b++) {
-            BuyerKey *buyer = (BuyerKey *)buyer_leaf->pointers[b];
-            
-            // For each buyer, traverse their transactions
-            node *trans_leaf = find_leftmost_leaf(buyer->transaction_tree);
-            while (trans_leaf != NULL && pair_count < MAX_BUYERS * MAX_SELLERS) {
-                for (int t = 0; t < trans_leaf->num_keys; t++) {
-                    Transaction *trans = (Transaction *)trans_leaf->pointers[t];
-                    
-                    // Check if this pair already exists
-                    bool found = false;
-                    for (int p = 0; p < pair_count; p++) {
-                        if (pairs[p].buyer_id == buyer->buyer_id && 
-                            pairs[p].seller_id == trans->seller_id) {
-                            pairs[p].transaction_count++;
-                            found = true;
-                            break;
-                        }
-                    }
-                    
-                    if (!found && pair_count < MAX_BUYERS * MAX_SELLERS) {
-                        pairs[pair_count].buyer_id = buyer->buyer_id;
-                        pairs[pair_count].seller_id = trans->seller_id;
-                        pairs[pair_count].transaction_count = 1;
-                        pair_count++;
-                    }
-                }
-                trans_leaf = trans_leaf->next;
-            }
-        }
-        buyer_leaf = buyer_leaf->next;
-    }
-
-    // Bubble sort (keeping original sorting approach)
-    for (int i = 0; i < pair_count - 1; i++) {
-        for (int j = 0; j < pair_count - i - 1; j++) {
-            if (pairs[j].transaction_count < pairs[j+1].transaction_count) {
-                Pair temp = pairs[j];
-                pairs[j] = pairs[j+1];
-                pairs[j+1] = temp;
-            }
-        }
-    }
-
-    // Display results
-    for (int i = 0; i < pair_count; i++) {
-        printf("%-8d %-8d %-15d\n", 
-               pairs[i].buyer_id, 
-               pairs[i].seller_id, 
-               pairs[i].transaction_count);
-    }
-}
-
-void transactions_in_time_range(const char *start_str, const char *end_str) {
-    printf("\nTransactions from %s to %s:\n", start_str, end_str);
-    printf("%-5s %-8s %-8s %-12s %-12s %-12s %-20s\n", 
-           "ID", "Buyer", "Seller", "Energy(kWh)", "Price/kWh", "Total($)", "Time");
-    printf("---------------------------------------------------------------------------------\n");
-    
-    node *leaf = find_leftmost_leaf(global_transaction_tree);
-    while (leaf) {
-        for (int i = 0; i < leaf->num_keys; i++) {
-            Transaction *t = (Transaction *)leaf->pointers[i];
-            if (strcmp(t->datetime, start_str) >= 0 && strcmp(t->datetime, end_str) <= 0) {
-                printf("%-5d %-8d %-8d %-12.2f %-12.2f %-12.2f %s\n",
-                       t->transaction_id, t->buyer_id, t->seller_id, 
-                       t->energy_kwh, t->price_per_kwh, t->total_price, t->datetime);
-            }
-        }
-        leaf = leaf->next;
-    }
-}
-
-void save_transactions_to_file() {
-    FILE *file = fopen("transactions.txt", "w");
-    if (file == NULL) {
-        printf("Error: Could not create transactions.txt\n");
-        return;
-    }
-
-    fprintf(file, "# transaction_id,buyer_id,seller_id,energy_kwh,rate_below_300,rate_above_300,datetime\n");
-
-    int saved_count = 0;
-    node *leaf = find_leftmost_leaf(global_transaction_tree);
-
-    while (leaf != NULL) {
-        for (int i = 0; i < leaf->num_keys; i++) {
-            if (leaf->pointers[i] == NULL) continue;
-
-            Transaction *t = (Transaction *)leaf->pointers[i];
-            fprintf(file, "%d,%d,%d,%.2f,%.2f,%.2f,%s\n",
-                   t->transaction_id, t->buyer_id, t->seller_id,
-                   t->energy_kwh, t->rate_below_300, t->rate_above_300,
-                   t->datetime);
-            saved_count++;
-        }
-        leaf = leaf->next;
-    }
-
-    
-
-    fclose(file);
-    
-}
-
-void load_transactions_from_file() {
-    FILE *file = fopen("transactions.txt", "r");
-    if (file == NULL) {
-        printf("Info: No existing transaction file found. Starting fresh.\n");
-        return;
-    }
-
-    printf("Loading transactions from file...\n");
-    char line[256];
-    int line_num = 0;
-    int loaded_count = 0;
-    int skipped_count = 0;
-    bool loading_sellers = false;
-
-    while (fgets(line, sizeof(line), file)) {
-        line_num++;
-
-        // Skip empty lines or comments
-        if (line[0] == '\n' || line[0] == '#') {
-            if (strstr(line, "# Sellers")) {
-                loading_sellers = true;
-            }
-            continue;
-        }
-
-        // Remove newline character
-        line[strcspn(line, "\n")] = '\0';
-
-        if (!loading_sellers) {
-            // Parse transaction line
-            Transaction t;
-            char datetime_str[20];
-            int matched = sscanf(line, "%d,%d,%d,%f,%f,%f,%19[^,]", 
-                               &t.transaction_id, &t.buyer_id, &t.seller_id,
-                               &t.energy_kwh, &t.rate_below_300, &t.rate_above_300,
-                               datetime_str);
-
-            if (matched != 7) {
-                printf("Line %d: Skipped transaction - Malformed (fields=%d)\n", line_num, matched);
-                skipped_count++;
-                continue;
-            }
-
-            if (!validate_datetime(datetime_str)) {
-                printf("Line %d: Skipped - Invalid datetime format: %s\n", line_num, datetime_str);
-                skipped_count++;
-                continue;
-            }
-
-            strncpy(t.datetime, datetime_str, sizeof(t.datetime));
-
-            // Check for duplicate transaction ID
-            bool is_duplicate = false;
-            node *check_leaf = find_leftmost_leaf(global_transaction_tree);
-            while (check_leaf) {
-                for (int i = 0; i < check_leaf->num_keys; i++) {
-                    Transaction *existing = (Transaction *)check_leaf->pointers[i];
-                    if (existing->transaction_id == t.transaction_id) {
-                        is_duplicate = true;
-                        break;
-                    }
-                }
-                if (is_duplicate) break;
-                check_leaf = check_leaf->next;
-            }
-
-            if (is_duplicate) {
-                printf("Line %d: Skipped - Duplicate transaction ID %d\n", line_num, t.transaction_id);
-                skipped_count++;
-                continue;
-            }
-
-            // Create seller if needed
-            SellerKey *s = get_or_create_seller(t.seller_id, t.rate_below_300, t.rate_above_300);
-
-            // Calculate price
-            if (t.energy_kwh <= ENERGY_THRESHOLD) {
-                t.price_per_kwh = s->rate_below_300;
-            } else {
-                float below_price = ENERGY_THRESHOLD * s->rate_below_300;
-                float above_price = (t.energy_kwh - ENERGY_THRESHOLD) * s->rate_above_300;
-                t.price_per_kwh = (below_price + above_price) / t.energy_kwh;
-            }
-            t.total_price = calculate_price(s, t.energy_kwh, t.buyer_id);
-
-            // Create transaction
-            Transaction *new_t = (Transaction *)malloc(sizeof(Transaction));
-            if (!new_t) {
-                printf("Line %d: Error - Memory allocation failed\n", line_num);
-                skipped_count++;
-                continue;
-            }
-            *new_t = t;
-
-            // Add to trees
-            all_transactions[transaction_index++] = new_t;
-            global_transaction_tree = insert_transaction(global_transaction_tree, new_t);
-            
-            s->transaction_tree = insert_transaction(s->transaction_tree, new_t);
-            s->transaction_count++;
-
-            BuyerKey *b = get_or_create_buyer(t.buyer_id);
-            b->transaction_tree = insert_transaction(b->transaction_tree, new_t);
-            b->total_energy_purchased += t.energy_kwh;
-            b->transaction_count++;
-
-            loaded_count++;
-        } else {
-            // Parse seller information
-            int seller_id;
-            float rate_below, rate_above;
-            int regular_count;
-            char *token = strtok(line, ",");
-            
-            if (token == NULL) continue;
-            seller_id = atoi(token);
-            
-            token = strtok(NULL, ",");
-            if (token == NULL) continue;
-            rate_below = atof(token);
-            
-            token = strtok(NULL, ",");
-            if (token == NULL) continue;
-            rate_above = atof(token);
-            
-            token = strtok(NULL, ",");
-            if (token == NULL) continue;
-            regular_count = atoi(token);
-            
-            SellerKey *s = get_or_create_seller(seller_id, rate_below, rate_above);
-            s->regular_buyer_count = regular_count;
-            
-            for (int i = 0; i < regular_count && i < MAX_BUYERS; i++) {
-                token = strtok(NULL, ",");
-                if (token == NULL) break;
-                s->regular_buyers[i] = atoi(token);
-            }
-        }
-    }
-
-    fclose(file);
-   
-}
-// ---------------------------- Main Menu ----------------------------
-
-int main() {
-    // Initialize global trees
-    global_transaction_tree = NULL;
-    seller_tree = NULL;
-    buyer_tree = NULL;
-    transaction_index = 0;
-
-    // Load existing data
-    load_transactions_from_file();
-
-    int choice;
-    do {
-        printf("\n==== Energy Trading Record Management System ====\n");
-        printf("1. Add New Transaction\n");
-        printf("2. Display All Transactions\n");
-        printf("3. Transactions for Every Seller\n");
-        printf("4. Transactions for Every Buyer\n");
-        printf("5. Total Revenue by Seller\n");
-        printf("6. Transactions in Energy Range\n");
-        printf("7. Sort Buyers by Energy Bought\n");
-        printf("8. Sort Buyer/Seller Pairs\n");
-        printf("9. Transactions in Time Range\n");
-        printf("0. Exit\n");
-        printf("Choice: ");
-        scanf("%d", &choice);
-
-        switch(choice) {
-            case 1: {
-                printf("\nEnter Transaction Details:\n");
-                int transaction_id, buyer_id, seller_id;
-                float energy_kwh, rate_below_300, rate_above_300;
-                char datetime[20];
-                
-                printf("Transaction ID: ");
-                scanf("%d", &transaction_id);
-                printf("Buyer ID: ");
-                scanf("%d", &buyer_id);
-                printf("Seller ID: ");
-                scanf("%d", &seller_id);
-                printf("Energy (kWh): ");
-                scanf("%f", &energy_kwh);
-                
-                // Check if seller exists to get existing rates
-                SellerKey *existing_seller = NULL;
-                node *seller_leaf = find_leftmost_leaf(seller_tree);
-                while (seller_leaf) {
-                    for (int i = 0; i < seller_leaf->num_keys; i++) {
-                        SellerKey *s = (SellerKey *)seller_leaf->pointers[i];
-                        if (s->seller_id == seller_id) {
-                            existing_seller = s;
-                            break;
-                        }
-                    }
-                    if (existing_seller) break;
-                    seller_leaf = seller_leaf->next;
-                }
-                
-                if (existing_seller) {
-                    rate_below_300 = existing_seller->rate_below_300;
-                    rate_above_300 = existing_seller->rate_above_300;
-                    printf("Using existing rates for Seller %d: %.2f$/kWh (≤300kWh), %.2f$/kWh (>300kWh)\n", 
-                           seller_id, rate_below_300, rate_above_300);
-                } else {
-                    printf("Enter rate for energy <= 300 kWh ($/kWh): ");
-                    scanf("%f", &rate_below_300);
-                    printf("Enter rate for energy > 300 kWh ($/kWh): ");
-                    scanf("%f", &rate_above_300);
-                }
-                
-                printf("Enter date and time (YYYY-MM-DD HH:MM): ");
-                scanf(" %19[^\n]", datetime);
-                while(!validate_datetime(datetime)) {
-                    printf("Invalid datetime format.\n");
-                    printf("Enter date and time (YYYY-MM-DD HH:MM): ");
-                    scanf(" %19[^\n]", datetime);
-                    
-                }
-                
-                Transaction *t = (Transaction *)malloc(sizeof(Transaction));
-                t->transaction_id = transaction_id;
-                t->buyer_id = buyer_id;
-                t->seller_id = seller_id;
-                t->energy_kwh = energy_kwh;
-                strncpy(t->datetime, datetime, sizeof(t->datetime));
-                t->rate_below_300 = rate_below_300;
-                t->rate_above_300 = rate_above_300;
-                
-                SellerKey *s = get_or_create_seller(seller_id, rate_below_300, rate_above_300);
-                
-                // Calculate price
-                if (energy_kwh <= ENERGY_THRESHOLD) {
-                    t->price_per_kwh = s->rate_below_300;
-                } else {
-                    t->price_per_kwh = s->rate_above_300;
-                }
-                
-                t->total_price = calculate_price(s, energy_kwh, buyer_id);
-                
-                if (add_transaction(t)) {
-                    save_transactions_to_file();
-                    printf("Transaction added successfully!\n");
-                }
-                break;
-            
-            case 2:
-                display_all_transactions();
-                break;
-            case 3:
-                transactions_by_seller();
-                break;
-            case 4:
-                transactions_by_buyer();
-                break;
-            case 5:
-                total_revenue_by_seller();
-                break;
-            case 6: {
-                float min, max;
-                printf("\nEnter min energy (kWh): ");
-                scanf("%f", &min);
-                printf("Enter max energy (kWh): ");
-                scanf("%f", &max);
-                energy_range_transactions(min, max);
-                break;
-            }
-            case 7:
-                sort_buyers_by_energy();
-                break;
-            case 8:
-                sort_pairs_by_transaction_count();
-                break;
-            case 9: {
-                char start_str[20], end_str[20];
-                bool isvalid = false;
-                while(!isvalid) {
-                    printf("Enter start time (YYYY-MM-DD HH:MM): ");
-                    scanf(" %19[^\n]", start_str);
-                    printf("Enter end time (YYYY-MM-DD HH:MM): ");
-                    scanf(" %19[^\n]", end_str);
-                    if (!validate_datetime(start_str) || !validate_datetime(end_str)) {
-                        printf("Invalid datetime format. Try again.\n");
-                    }
-                    else isvalid = true;
-                } 
-                transactions_in_time_range(start_str, end_str);
-                break;
-            }
-            case 0:
-                printf("Exiting...\n");
-                break;
-            default:
-                printf("Invalid choice. Please try again.\n");
-        }
-    }} while (choice != 0);
-
-    
-
-    return 0;
-}
-
-
+#define _GNU_SOURCE             // getline, open_memstream, fmemopen, pread, realpath, syscall
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#ifndef ORDER
+#define ORDER 6                      // Override with -DORDER=n to benchmark other fan-outs
+#endif
+#if ORDER < 4
+#error "ORDER must be at least 4"
+#endif
+#define REGULAR_CUSTOMER_THRESHOLD 5
+#define IDMAP_INITIAL_CAPACITY 64
+#define ID_ARRAY_MAX 4096            // Id set containers switch to a bitmap past this
+#define ID_BITMAP_WORDS 1024         // 65536 bits
+#define ENERGY_SCALE 1000LL          // energy_t units per kWh (milli-kWh)
+#define MONEY_SCALE 1000000LL        // money_t units per dollar (micro-dollars)
+#define ENERGY_THRESHOLD (300 * ENERGY_SCALE)
+#define REGULAR_DISCOUNT_PERCENT 5
+#define COLD_STORAGE_AGE_DAYS 28     // Trades this much older than the newest one are sealed
+#define COLD_SEGMENT_ROWS 4096       // Maximum rows per sealed segment
+#define COLD_SEAL_BATCH 1024         // Hot inserts between seal attempts
+#define MINUTES_PER_DAY 1440
+#define REPORT_CACHE_ENTRIES 32
+#define REPORT_CACHE_MAX_BYTES (4 * 1024 * 1024)
+#define TRANSACTIONS_FILE "transactions.txt"
+#define CHECKPOINT_FILE "transactions.ckpt"
+#define CHECKPOINT_TEMP_FILE "transactions.ckpt.tmp"
+#define CHECKPOINT_MAGIC "ETCK"
+#define CHECKPOINT_VERSION 3
+#define CHECKPOINT_TAIL_BYTES 64
+#define CHECKPOINT_INTERVAL 10000     // Trades between automatic checkpoints
+#define CHECKPOINT_WAIT_SECONDS 30    // How long a background checkpoint waits for its journal row
+#define SKETCH_TOP_K 64              // Space-Saving counters per summary
+#define SKETCH_REPORT_TOP 20
+#define COUNT_MIN_DEPTH 4            // Estimates hold with probability 1 - e^-4 (98%)
+#define COUNT_MIN_WIDTH 2048
+#define REPLICA_SHM_NAME "/energy_trading"  // Prefix; the data file's path is hashed onto it
+#define REPLICA_MAGIC "ETRS"
+#define REPLICA_VERSION 2
+#define REPLICA_SEGMENT_ARRAYS 11   // Payload arrays per cold segment
+#define REPLICA_PUBLISH_INTERVAL 1000 // Trades between published versions
+#define TRANSACTIONS_HEADER "# transaction_id,buyer_id,seller_id,energy_kwh,rate_below_300,rate_above_300,datetime"
+#define PERSIST_QUEUE_CAPACITY 4096  // Power of two
+#define PERSIST_BUFFER_BYTES (64 * 1024)
+#define PERSIST_MAX_ROW_BYTES 256
+#define MAX_REPORT_WORKERS 64
+#define PARALLEL_MIN_TASKS 64        // Smaller reports are not worth handing out
+#define REPORT_MAX_ROW_BYTES 512     // Upper bound on one formatted row in any format
+#define REPORT_WRITE_BUFFER_BYTES (1024 * 1024)
+#define BINARY_EXPORT_MAGIC "ETRB"
+#define BINARY_EXPORT_VERSION 1
+#define BINARY_RECORD_BYTES 64
+#define BENCH_KEYS 200000            // Keys per benchmark tree
+#define BENCH_REPEATS 9              // The median of this many runs is reported
+#define BENCH_EVENTS 3               // cycles, cache misses, branch misses
+#define BENCH_MAX_RESULTS 32
+#define BENCH_BASELINE_FILE "bench_baseline.txt"
+#define BENCH_REGRESSION_PERCENT 10.0       // Threshold when cycles are compared
+#define BENCH_WALL_REGRESSION_PERCENT 25.0  // Wall time alone is too noisy to fail on; only flagged
+#define BENCH_EVENT_SCALE 1000       // Baseline per-op figures are stored x1000 as integers
+
+// ---------------------------- Structures ----------------------------
+
+// Fixed-point quantities: exact to sum, compare and sort as integers.
+typedef int64_t energy_t;   // milli-kWh
+typedef int64_t money_t;    // micro-dollars (rates are micro-dollars per kWh)
+
+typedef struct Transaction {
+    int transaction_id;
+    int buyer_id;
+    int seller_id;
+    energy_t energy_kwh;
+    money_t price_per_kwh;
+    money_t total_price;
+    char datetime[20]; // Format: "YYYY-MM-DD HH:MM"
+    money_t rate_below_300; 
+    money_t rate_above_300;  
+} Transaction;
+
+typedef struct node {
+    void **pointers;
+    int *keys;
+    struct node *parent;
+    bool is_leaf;
+    int num_keys;
+    struct node *next;
+} node;
+
+// Composite key of the participant time indexes. transaction_id breaks ties
+// so trades in the same minute still get distinct keys.
+typedef struct TimeKey {
+    int participant;            // Dense seller or buyer index
+    int transaction_id;
+    int64_t minutes;            // See datetime_to_minutes()
+} TimeKey;
+
+typedef struct TimeNode {
+    void **pointers;
+    TimeKey *keys;
+    bool is_leaf;
+    int num_keys;
+    struct TimeNode *next;
+} TimeNode;
+
+typedef struct TimeIndexScan {
+    TimeNode *leaf;
+    int slot;
+    TimeKey high;               // Last key the scan may return
+} TimeIndexScan;
+
+// Participant records live in the contiguous `sellers` / `buyers` arrays and
+// are addressed by the dense index handed out by the id interning maps.
+typedef struct SellerKey {
+    int seller_id;
+    money_t rate_below_300;
+    money_t rate_above_300;
+    node *transaction_tree;
+    int transaction_count;
+    money_t sealed_revenue;     // Totals of this seller's trades in cold segments
+    energy_t sealed_energy;
+} SellerKey;
+
+typedef struct BuyerKey {
+    int buyer_id;
+    energy_t total_energy_purchased;
+    node *transaction_tree;
+    int transaction_count;
+} BuyerKey;
+
+// Trade statistics for one (buyer, seller) pair, keyed by dense indices.
+typedef struct PairStats {
+    int buyer_index;
+    int seller_index;
+    int transaction_count;
+    int first_transaction_id; // Smallest transaction id seen for the pair
+    bool is_regular;
+} PairStats;
+
+// Open-addressing hash map from a 64-bit key to a dense index.
+typedef struct IdMap {
+    uint64_t *keys;
+    int *values;    // -1 marks an empty slot
+    int capacity;   // Always a power of two
+    int count;
+} IdMap;
+
+// One id set bucket: the low 16 bits of the ids sharing `high`
+typedef struct IdContainer {
+    uint32_t high;
+    int count;
+    uint16_t *values;           // Sorted, while bits == NULL
+    int capacity;
+    uint64_t *bits;             // ID_BITMAP_WORDS words once dense
+} IdContainer;
+
+typedef struct IdSet {
+    IdMap directory;            // High 16 bits -> container index
+    IdContainer *containers;
+    int container_count;
+    int container_capacity;
+    long count;
+} IdSet;
+
+// Frame-of-reference bit-packed integer column: value = base + packed bits.
+typedef struct PackedColumn {
+    uint64_t *words;
+    int64_t base;
+    int bits;
+} PackedColumn;
+
+// Immutable columnar block of sealed historical trades, sorted by
+// transaction_id. Ids and timestamps are varint deltas decoded
+// sequentially; everything else is randomly addressable.
+typedef struct ColdSegment {
+    int row_count;
+
+    // Zone maps used to skip the segment entirely
+    int min_transaction_id;
+    int max_transaction_id;
+    int64_t min_timestamp;      // Minutes, see datetime_to_minutes()
+    int64_t max_timestamp;
+    energy_t min_energy;
+    energy_t max_energy;
+
+    uint8_t *id_deltas;         // First id zigzag-encoded, then gaps
+    uint8_t *timestamp_deltas;  // Zigzag deltas from the previous row
+    size_t id_bytes;
+    size_t timestamp_bytes;
+
+    int *buyer_dict;            // Sorted dense buyer indices
+    int buyer_dict_size;
+    int *seller_dict;           // Sorted dense seller indices
+    int seller_dict_size;
+    money_t *rate_dict;         // (rate_below_300, rate_above_300) pairs
+    int rate_dict_size;
+
+    PackedColumn buyer_codes;
+    PackedColumn seller_codes;
+    PackedColumn rate_codes;
+    PackedColumn energy;
+    PackedColumn price_per_kwh;
+    PackedColumn total_price;
+} ColdSegment;
+
+// Restricts which cold rows a TransactionCursor yields. Hot rows come
+// from the tree the cursor is opened on and are not filtered.
+typedef struct TransactionFilter {
+    int seller_index;           // -1 for any seller
+    int buyer_index;            // -1 for any buyer
+    energy_t min_energy;
+    energy_t max_energy;
+    int64_t min_timestamp;
+    int64_t max_timestamp;
+} TransactionFilter;
+
+typedef struct SegmentCursor {
+    const ColdSegment *segment;
+    int row;                    // Index of `current`
+    const uint8_t *id_pos;
+    const uint8_t *timestamp_pos;
+    int64_t timestamp;
+    int seller_code;            // -1 when not filtering by seller
+    int buyer_code;             // -1 when not filtering by buyer
+    Transaction current;
+} SegmentCursor;
+
+// One sealed row located by segment and row, with the fields that have to
+// be decoded sequentially already filled in.
+typedef struct ColdRowRef {
+    int transaction_id;
+    int segment;
+    int row;
+    int64_t timestamp;
+} ColdRowRef;
+
+// Sealed rows grouped by seller or buyer index, each group in
+// transaction_id order: rows of participant p are refs[starts[p]] up to
+// refs[starts[p + 1]].
+typedef struct ColdRowIndex {
+    int *starts;
+    ColdRowRef *refs;
+} ColdRowIndex;
+
+// Merges a hot B+ tree with the cold segments in transaction_id order.
+typedef struct TransactionCursor {
+    node *leaf;
+    int slot;
+    SegmentCursor *heap;        // Min-heap on current.transaction_id
+    int heap_size;
+    bool advance_top;           // The heap top was returned by the last call
+    TransactionFilter filter;
+    const ColdRowRef *refs;     // Cold rows instead of the heap, see cursor_open_refs()
+    int ref_count;
+    Transaction ref_row;
+} TransactionCursor;
+
+// Growable text buffer a report is rendered into before it is printed.
+typedef struct ReportBuffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+} ReportBuffer;
+
+typedef enum ReportFormat {
+    FORMAT_CSV,
+    FORMAT_JSON_LINES,
+    FORMAT_BINARY
+} ReportFormat;
+
+// Streams rows to a file descriptor through one reusable buffer instead of
+// holding the whole report in memory.
+typedef struct ReportWriter {
+    ReportBuffer buf;
+    int fd;
+    bool failed;
+} ReportWriter;
+
+typedef enum ReportKind {
+    REPORT_REVENUE_BY_SELLER,
+    REPORT_BUYERS_BY_ENERGY,
+    REPORT_PAIRS_BY_COUNT,
+    REPORT_ENERGY_RANGE,        // low/high: energy bounds
+    REPORT_TIME_RANGE           // low/high: timestamp bounds in minutes
+} ReportKind;
+
+typedef struct ReportKey {
+    ReportKind kind;
+    int64_t low;
+    int64_t high;
+} ReportKey;
+
+typedef struct ReportCacheEntry {
+    bool valid;
+    ReportKey key;
+    char *text;
+    size_t length;
+    uint64_t last_used;
+} ReportCacheEntry;
+
+typedef struct PersistBuffer {
+    char data[PERSIST_BUFFER_BYTES];
+    size_t length;
+    uint64_t last_sequence;     // Queue position just past the last row formatted
+} PersistBuffer;
+
+// State shared by the operator thread and the two persistence threads.
+typedef struct Persistence {
+    Transaction queue[PERSIST_QUEUE_CAPACITY];
+    _Atomic uint64_t head;      // Next slot the formatter reads
+    _Atomic uint64_t tail;      // Next slot the operator thread fills
+    _Atomic bool formatter_waiting;
+
+    PersistBuffer buffers[2];
+    int front;                  // Buffer the formatter fills; the other is the writer's
+    bool back_full;             // Writer owns a filled back buffer
+    uint64_t durable;           // Trades before this queue position are fsynced
+    _Atomic int error;          // errno of the first failed write or fsync; 0 if none
+    bool stopping;
+    bool writer_stopping;
+    bool running;
+    int fd;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;        // Formatter: queue non-empty or stopping
+    pthread_cond_t writer_work; // Writer: back buffer ready or stopping
+    pthread_cond_t progress;    // Back buffer written, durable advanced
+    pthread_t formatter;
+    pthread_t writer;
+} Persistence;
+
+typedef void (*TaskFn)(int task, int worker, void *ctx);
+typedef void (*RenderFn)(int task, ReportBuffer *out, void *ctx);
+
+typedef struct WorkerDeque {
+    pthread_mutex_t lock;
+    int begin;                  // Owner takes from here
+    int end;                    // Thieves take from here
+} WorkerDeque;
+
+typedef struct TaskPool {
+    bool started;
+    int worker_count;           // Including the thread that calls parallel_for()
+    WorkerDeque deques[MAX_REPORT_WORKERS];
+    TaskFn fn;
+    void *ctx;
+    uint64_t generation;        // Bumped for every parallel_for()
+    int active;                 // Pool threads still working on this generation
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+} TaskPool;
+
+typedef struct ReportSpan {
+    int worker;
+    size_t offset;
+    size_t length;
+} ReportSpan;
+
+typedef struct SpaceSavingEntry {
+    uint64_t key;
+    int64_t count;              // Estimate, never below the true value
+    int64_t error;              // Most the estimate can exceed the true value by
+} SpaceSavingEntry;
+
+typedef struct SpaceSaving {
+    SpaceSavingEntry entries[SKETCH_TOP_K];
+    int size;
+    int64_t total;              // Sum of all weights added
+} SpaceSaving;
+
+typedef struct CountMin {
+    uint32_t counts[COUNT_MIN_DEPTH][COUNT_MIN_WIDTH];
+    int64_t total;
+} CountMin;
+
+typedef struct TradeSketches {
+    SpaceSaving buyer_energy;   // Buyer id -> energy bought (milli-kWh)
+    SpaceSaving pair_trades;    // (buyer id, seller id) -> trade count
+    CountMin pair_counts;       // (buyer id, seller id) -> trade count
+} TradeSketches;
+
+// Fixed header of CHECKPOINT_FILE; the payload that follows is the engine
+// state in the order write_checkpoint() emits it.
+// A forked child working on a copy-on-write snapshot of the engine.
+typedef struct BackgroundJob {
+    pid_t pid;                  // 0 when no job is running
+    int result_fd;              // Parent: read end of the result pipe; child: write end
+} BackgroundJob;
+
+typedef enum JobState {
+    JOB_IDLE,
+    JOB_RUNNING,
+    JOB_DONE,                   // Finished and sent its result
+    JOB_FAILED
+} JobState;
+
+// What a background checkpoint covers, sent back to the parent.
+typedef struct CheckpointResult {
+    int64_t journal_offset;
+    int64_t journal_lines;
+} CheckpointResult;
+
+typedef struct CheckpointHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_sizes[5];   // Transaction, SellerKey, BuyerKey, PairStats, ColdSegment
+    int64_t journal_offset;     // Bytes of TRANSACTIONS_FILE the state covers
+    int64_t journal_lines;      // Lines in those bytes
+    uint32_t journal_in_sellers; // Those bytes end inside a "# Sellers" section
+    uint32_t tail_length;
+    uint8_t journal_tail[CHECKPOINT_TAIL_BYTES];  // Journal bytes just before journal_offset
+    uint64_t payload_bytes;
+    uint64_t payload_checksum;  // FNV-1a of the payload
+} CheckpointHeader;
+
+// Start of a published replica image. Every *_offset is in bytes from the
+// start of the image.
+typedef struct ReplicaHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_sizes[5];   // Transaction, SellerKey, BuyerKey, PairStats, ColdSegment
+    uint64_t generation;
+    uint64_t total_bytes;
+    int seller_count;
+    int buyer_count;
+    int pair_count;
+    int hot_count;
+    int segment_count;
+    int cold_row_count;
+    int64_t latest_timestamp;
+    int64_t oldest_hot_timestamp;
+    uint64_t sellers_offset;    // SellerKey[seller_count], tree roots zeroed
+    uint64_t buyers_offset;     // BuyerKey[buyer_count], tree roots zeroed
+    uint64_t pairs_offset;      // PairStats[pair_count]
+    uint64_t hot_offset;        // Transaction[hot_count]
+    uint64_t segments_offset;   // ColdSegment[segment_count], pointers zeroed
+    uint64_t segment_payloads_offset;  // ReplicaSegment[segment_count]
+    uint64_t sketches_offset;   // TradeSketches
+} ReplicaHeader;
+
+// Where each pointer field of a ColdSegment lives inside the image, in the
+// order id_deltas, timestamp_deltas, buyer_dict, seller_dict, rate_dict and
+// the six packed columns.
+typedef struct ReplicaSegment {
+    uint64_t offsets[REPLICA_SEGMENT_ARRAYS];
+} ReplicaSegment;
+
+// Small fixed object naming the current version for attaching replicas.
+typedef struct ReplicaControl {
+    _Atomic uint64_t generation;    // Version <control name>.<generation> is current
+    _Atomic int writer_pid;         // 0 once the writer has exited
+} ReplicaControl;
+
+typedef enum BenchPattern {
+    BENCH_SEQUENTIAL,
+    BENCH_REVERSE,
+    BENCH_RANDOM,
+    BENCH_PATTERNS
+} BenchPattern;
+
+// One measurement; events[] is -1 where the counter could not be read.
+typedef struct BenchSample {
+    double ns;
+    int64_t events[BENCH_EVENTS];
+} BenchSample;
+
+typedef struct BenchResult {
+    char operation[24];
+    char pattern[12];
+    long ops;
+    BenchSample median;
+} BenchResult;
+
+// Hardware counters read as one perf_event group; fds[0] leads.
+typedef struct BenchCounters {
+    int fds[BENCH_EVENTS];
+    int slots[BENCH_EVENTS];    // Position of each event in the group read, -1 if absent
+    int opened;
+} BenchCounters;
+// ---------------------------- Globals ----------------------------
+
+
+SellerKey *sellers = NULL;
+int seller_count = 0;
+int seller_capacity = 0;
+IdMap seller_ids = {0};
+int *seller_order = NULL;       // Dense indices sorted by seller_id
+bool seller_order_dirty = false;
+
+BuyerKey *buyers = NULL;
+int buyer_count = 0;
+int buyer_capacity = 0;
+IdMap buyer_ids = {0};
+int *buyer_order = NULL;        // Dense indices sorted by buyer_id
+bool buyer_order_dirty = false;
+
+PairStats *pairs = NULL;
+int pair_count = 0;
+int pair_capacity = 0;
+IdMap pair_ids = {0};
+
+IdSet transaction_ids = {0};       // Every accepted id, hot or sealed
+TradeSketches trade_sketches;
+
+node *global_transaction_tree=NULL;
+Transaction **all_transactions = NULL;  // Hot (unsealed) transactions
+int transaction_index=0;
+int transaction_capacity = 0;
+TimeNode *seller_time_index = NULL;     // Hot trades keyed by (seller, time)
+TimeNode *buyer_time_index = NULL;      // Hot trades keyed by (buyer, time)
+
+bool tiered_storage = true;        // Cleared by --no-tiering to keep every trade hot
+ColdSegment *cold_segments = NULL;
+int cold_segment_count = 0;
+int cold_segment_capacity = 0;
+int cold_row_count = 0;
+int64_t latest_timestamp = INT64_MIN;       // Newest trade seen so far
+int64_t oldest_hot_timestamp = INT64_MAX;   // Oldest trade still in the trees
+int hot_inserts_since_seal = 0;
+
+ReportCacheEntry report_cache[REPORT_CACHE_ENTRIES];
+size_t report_cache_bytes = 0;
+uint64_t report_cache_clock = 0;
+long report_cache_hits = 0;
+long report_cache_misses = 0;
+long report_cache_invalidations = 0;
+long report_cache_evictions = 0;
+
+Persistence persistence;
+TaskPool task_pool;
+bool file_ends_in_sellers = false;  // Set by load_transactions_from_file()
+int64_t journal_known_bytes = 0;    // Journal prefix whose line count is known
+int64_t journal_known_lines = 0;
+int trades_since_checkpoint = 0;    // Trades added this session since the last checkpoint
+int journal_replayed_trades = 0;    // Rows the last load replayed past the checkpoint
+BackgroundJob checkpoint_job;
+int checkpoint_job_trades = 0;      // trades_since_checkpoint when checkpoint_job started
+int checkpoint_due = CHECKPOINT_INTERVAL;   // Pushed back after a failed attempt
+
+ReplicaControl *replica_control = NULL;
+bool replica_publishing = false;    // Writer started with --publish
+char replica_control_name[40];      // Set by replica_name_init()
+uint64_t replica_generation = 0;    // Version published (writer) or mapped (replica)
+char *replica_base = NULL;          // Replica: the mapped image
+size_t replica_bytes = 0;
+int trades_since_publish = 0;
+BackgroundJob replica_job;
+
+// ---------------------------- B+ Tree Helpers ----------------------------
+
+node *create_node(bool is_leaf) {
+    node *new_node=(node *)malloc(sizeof(node));
+    if (!new_node) {
+        printf("Memory allocation failed for node.\n");
+        exit(1);
+    }
+    new_node->pointers=(void **)malloc((ORDER + 1) * sizeof(void *));
+    new_node->keys=(int *)malloc((ORDER - 1) * sizeof(int));
+
+    if (!new_node->pointers || !new_node->keys) {
+        printf("Memory allocation failed for node components.\n");
+        exit(1);
+    }
+
+    new_node->parent=NULL;
+    new_node->is_leaf=is_leaf;
+    new_node->num_keys=0;
+    new_node->next=NULL;
+
+    return new_node;
+}
+
+void split_child(node *x, int index) {
+    node *y = (node *)x->pointers[index];
+    node *z = create_node(y->is_leaf);
+    z->parent = x;
+
+    // Internal nodes promote their median key, so both halves keep keys
+    int mid = y->is_leaf ? ORDER / 2 : (ORDER - 1) / 2;
+    int j = 0;
+
+    if (y->is_leaf) {
+        for (int i = mid; i < y->num_keys; i++) {
+            z->keys[j] = y->keys[i];
+            z->pointers[j] = y->pointers[i];
+            j++;
+        }
+        z->num_keys = y->num_keys - mid;
+        y->num_keys = mid;
+
+        z->next = y->next;
+        y->next = z;
+
+        for (int i = x->num_keys + 1; i > index + 1; i--) {
+            x->pointers[i] = x->pointers[i - 1];
+        }
+        for (int i = x->num_keys; i > index; i--) {
+            x->keys[i] = x->keys[i - 1];
+        }
+
+        x->keys[index] = z->keys[0];  // Copy first key from z
+        x->pointers[index + 1] = z;
+    } else {
+        for (int i = mid + 1; i < y->num_keys; i++) {
+            z->keys[j] = y->keys[i];
+            z->pointers[j] = y->pointers[i];
+            j++;
+        }
+        z->pointers[j] = y->pointers[y->num_keys];
+
+        z->num_keys = y->num_keys - mid - 1;
+        y->num_keys = mid;
+
+        for (int i = x->num_keys + 1; i > index + 1; i--) {
+            x->pointers[i] = x->pointers[i - 1];
+        }
+        for (int i = x->num_keys; i > index; i--) {
+            x->keys[i] = x->keys[i - 1];
+        }
+
+        x->keys[index] = y->keys[mid];
+        x->pointers[index + 1] = z;
+    }
+
+    x->num_keys++;
+}
+
+void insert_non_full(node *x, Transaction *t) {
+    int i = x->num_keys - 1;
+
+    if (x->is_leaf == true) {
+        while (i >= 0 && t->transaction_id < x->keys[i]) {
+            x->keys[i + 1] = x->keys[i];
+            x->pointers[i + 1] = x->pointers[i];
+            i = i - 1;
+        }
+
+        x->keys[i + 1] = t->transaction_id;
+        x->pointers[i + 1] = t;
+        x->num_keys = x->num_keys + 1;
+    } else {
+        while (i >= 0 && t->transaction_id < x->keys[i]) {
+            i = i - 1;
+        }
+        i = i + 1;
+
+        node *child = (node *)x->pointers[i];
+        if (child->num_keys == ORDER - 1) {
+            split_child(x, i);
+            if (t->transaction_id > x->keys[i]) {
+                i = i + 1;
+            }
+        }
+
+        insert_non_full((node *)x->pointers[i], t);
+    }
+}
+
+node *insert_transaction(node *root, Transaction *t) {
+    if (root == NULL) {
+        root = create_node(true);
+    }
+
+    if (root->num_keys == ORDER - 1) {
+        node *new_root = create_node(false);
+        new_root->pointers[0] = root;
+        root->parent = new_root;
+        split_child(new_root, 0);
+        insert_non_full(new_root, t);
+        return new_root;
+    } else {
+        insert_non_full(root, t);
+    }
+
+    return root;
+}
+
+node *find_leftmost_leaf(node *root) {
+    while (root != NULL && root->is_leaf == false) {
+        root = root->pointers[0];
+    }
+    return root;
+}
+
+// ---------------------------- Time Indexes ----------------------------
+
+// Composite-key B+ trees over (participant, time), one for sellers and one
+// for buyers, so a participant's trades in a time window are a seek plus a
+// walk along the leaves. Same layout and insert scheme as the id trees.
+
+int compare_time_keys(const TimeKey *a, const TimeKey *b) {
+    if (a->participant != b->participant) return a->participant < b->participant ? -1 : 1;
+    if (a->minutes != b->minutes) return a->minutes < b->minutes ? -1 : 1;
+    if (a->transaction_id != b->transaction_id) return a->transaction_id < b->transaction_id ? -1 : 1;
+    return 0;
+}
+
+TimeNode *create_time_node(bool is_leaf) {
+    TimeNode *new_node = (TimeNode *)malloc(sizeof(TimeNode));
+    if (!new_node) {
+        printf("Memory allocation failed for node.\n");
+        exit(1);
+    }
+    new_node->pointers = (void **)malloc((ORDER + 1) * sizeof(void *));
+    new_node->keys = (TimeKey *)malloc((ORDER - 1) * sizeof(TimeKey));
+
+    if (!new_node->pointers || !new_node->keys) {
+        printf("Memory allocation failed for node components.\n");
+        exit(1);
+    }
+
+    new_node->is_leaf = is_leaf;
+    new_node->num_keys = 0;
+    new_node->next = NULL;
+
+    return new_node;
+}
+
+void time_split_child(TimeNode *x, int index) {
+    TimeNode *y = (TimeNode *)x->pointers[index];
+    TimeNode *z = create_time_node(y->is_leaf);
+
+    // Internal nodes promote their median key, so both halves keep keys
+    int mid = y->is_leaf ? ORDER / 2 : (ORDER - 1) / 2;
+    int j = 0;
+
+    if (y->is_leaf) {
+        for (int i = mid; i < y->num_keys; i++) {
+            z->keys[j] = y->keys[i];
+            z->pointers[j] = y->pointers[i];
+            j++;
+        }
+        z->num_keys = y->num_keys - mid;
+        y->num_keys = mid;
+
+        z->next = y->next;
+        y->next = z;
+    } else {
+        for (int i = mid + 1; i < y->num_keys; i++) {
+            z->keys[j] = y->keys[i];
+            z->pointers[j] = y->pointers[i];
+            j++;
+        }
+        z->pointers[j] = y->pointers[y->num_keys];
+
+        z->num_keys = y->num_keys - mid - 1;
+        y->num_keys = mid;
+    }
+
+    for (int i = x->num_keys + 1; i > index + 1; i--) {
+        x->pointers[i] = x->pointers[i - 1];
+    }
+    for (int i = x->num_keys; i > index; i--) {
+        x->keys[i] = x->keys[i - 1];
+    }
+
+    // Leaves copy their first key up, internal nodes move the middle one
+    x->keys[index] = y->is_leaf ? z->keys[0] : y->keys[mid];
+    x->pointers[index + 1] = z;
+    x->num_keys++;
+}
+
+void time_insert_non_full(TimeNode *x, const TimeKey *key, Transaction *t) {
+    int i = x->num_keys - 1;
+
+    if (x->is_leaf) {
+        while (i >= 0 && compare_time_keys(key, &x->keys[i]) < 0) {
+            x->keys[i + 1] = x->keys[i];
+            x->pointers[i + 1] = x->pointers[i];
+            i--;
+        }
+
+        x->keys[i + 1] = *key;
+        x->pointers[i + 1] = t;
+        x->num_keys++;
+    } else {
+        while (i >= 0 && compare_time_keys(key, &x->keys[i]) < 0) {
+            i--;
+        }
+        i++;
+
+        TimeNode *child = (TimeNode *)x->pointers[i];
+        if (child->num_keys == ORDER - 1) {
+            time_split_child(x, i);
+            if (compare_time_keys(key, &x->keys[i]) >= 0) {
+                i++;
+            }
+        }
+
+        time_insert_non_full((TimeNode *)x->pointers[i], key, t);
+    }
+}
+
+TimeNode *time_index_insert(TimeNode *root, const TimeKey *key, Transaction *t) {
+    if (root == NULL) {
+        root = create_time_node(true);
+    }
+
+    if (root->num_keys == ORDER - 1) {
+        TimeNode *new_root = create_time_node(false);
+        new_root->pointers[0] = root;
+        time_split_child(new_root, 0);
+        time_insert_non_full(new_root, key, t);
+        return new_root;
+    }
+    time_insert_non_full(root, key, t);
+    return root;
+}
+
+void free_time_nodes(TimeNode *root) {
+    if (root == NULL) return;
+    if (!root->is_leaf) {
+        for (int i = 0; i <= root->num_keys; i++) {
+            free_time_nodes((TimeNode *)root->pointers[i]);
+        }
+    }
+    free(root->pointers);
+    free(root->keys);
+    free(root);
+}
+
+// Adds a hot trade to both time indexes; `minutes` is its datetime as
+// returned by datetime_to_minutes()
+void index_trade_times(Transaction *t, int64_t minutes, int seller_index, int buyer_index) {
+    TimeKey key = { seller_index, t->transaction_id, minutes };
+    seller_time_index = time_index_insert(seller_time_index, &key, t);
+    key.participant = buyer_index;
+    buyer_time_index = time_index_insert(buyer_time_index, &key, t);
+}
+
+// Positions a scan on the first key >= (participant, from) and stops it
+// after (participant, to)
+void time_scan_open(TimeIndexScan *scan, TimeNode *root, int participant, int64_t from, int64_t to) {
+    TimeKey low = { participant, INT_MIN, from };
+    while (root != NULL && !root->is_leaf) {
+        int i = 0;
+        while (i < root->num_keys && compare_time_keys(&low, &root->keys[i]) >= 0) i++;
+        root = (TimeNode *)root->pointers[i];
+    }
+    scan->leaf = root;
+    scan->slot = 0;
+    while (scan->leaf && scan->slot < scan->leaf->num_keys &&
+           compare_time_keys(&scan->leaf->keys[scan->slot], &low) < 0) {
+        scan->slot++;
+    }
+    scan->high.participant = participant;
+    scan->high.transaction_id = INT_MAX;
+    scan->high.minutes = to;
+}
+
+// Next indexed trade in (time, transaction_id) order, or NULL
+Transaction *time_scan_next(TimeIndexScan *scan) {
+    while (scan->leaf && scan->slot >= scan->leaf->num_keys) {
+        scan->leaf = scan->leaf->next;
+        scan->slot = 0;
+    }
+    if (!scan->leaf || compare_time_keys(&scan->leaf->keys[scan->slot], &scan->high) > 0) {
+        scan->leaf = NULL;
+        return NULL;
+    }
+    return (Transaction *)scan->leaf->pointers[scan->slot++];
+}
+
+// ---------------------------- ID Interning ----------------------------
+
+uint64_t idmap_hash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+void idmap_init(IdMap *map, int capacity) {
+    map->keys = (uint64_t *)malloc(capacity * sizeof(uint64_t));
+    map->values = (int *)malloc(capacity * sizeof(int));
+    if (!map->keys || !map->values) {
+        printf("Memory allocation failed for id map.\n");
+        exit(1);
+    }
+    for (int i = 0; i < capacity; i++) {
+        map->values[i] = -1;
+    }
+    map->capacity = capacity;
+    map->count = 0;
+}
+
+// Returns the dense index stored for key, or -1 if the key is unknown
+int idmap_find(const IdMap *map, uint64_t key) {
+    if (map->capacity == 0) return -1;
+
+    int mask = map->capacity - 1;
+    int slot = (int)(idmap_hash(key) & mask);
+    while (map->values[slot] != -1) {
+        if (map->keys[slot] == key) {
+            return map->values[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+void idmap_put(IdMap *map, uint64_t key, int value);
+
+void idmap_grow(IdMap *map) {
+    IdMap old = *map;
+    idmap_init(map, old.capacity ? old.capacity * 2 : IDMAP_INITIAL_CAPACITY);
+    for (int i = 0; i < old.capacity; i++) {
+        if (old.values[i] != -1) {
+            idmap_put(map, old.keys[i], old.values[i]);
+        }
+    }
+    free(old.keys);
+    free(old.values);
+}
+
+void idmap_put(IdMap *map, uint64_t key, int value) {
+    // Keep the load factor at or below 1/2 so probe chains stay short
+    if ((map->count + 1) * 2 > map->capacity) {
+        idmap_grow(map);
+    }
+
+    int mask = map->capacity - 1;
+    int slot = (int)(idmap_hash(key) & mask);
+    while (map->values[slot] != -1) {
+        if (map->keys[slot] == key) {
+            map->values[slot] = value;
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+    map->keys[slot] = key;
+    map->values[slot] = value;
+    map->count++;
+}
+
+// Grows a participant array so it can hold at least `needed` records
+void *grow_array(void *array, int *capacity, int needed, size_t elem_size) {
+    if (needed <= *capacity) return array;
+
+    int new_capacity = *capacity ? *capacity * 2 : 16;
+    while (new_capacity < needed) new_capacity *= 2;
+
+    void *grown = realloc(array, new_capacity * elem_size);
+    if (!grown) {
+        printf("Memory allocation failed for participant table.\n");
+        exit(1);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+int find_seller_index(int seller_id) {
+    return idmap_find(&seller_ids, (uint64_t)(uint32_t)seller_id);
+}
+
+int find_buyer_index(int buyer_id) {
+    return idmap_find(&buyer_ids, (uint64_t)(uint32_t)buyer_id);
+}
+
+SellerKey *find_seller(int seller_id) {
+    int index = find_seller_index(seller_id);
+    return index < 0 ? NULL : &sellers[index];
+}
+
+uint64_t pair_key(int buyer_index, int seller_index) {
+    return ((uint64_t)(uint32_t)buyer_index << 32) | (uint32_t)seller_index;
+}
+
+PairStats *find_pair(int buyer_index, int seller_index) {
+    int index = idmap_find(&pair_ids, pair_key(buyer_index, seller_index));
+    return index < 0 ? NULL : &pairs[index];
+}
+
+PairStats *get_or_create_pair(int buyer_index, int seller_index) {
+    PairStats *p = find_pair(buyer_index, seller_index);
+    if (p) return p;
+
+    pairs = (PairStats *)grow_array(pairs, &pair_capacity, pair_count + 1, sizeof(PairStats));
+    p = &pairs[pair_count];
+    p->buyer_index = buyer_index;
+    p->seller_index = seller_index;
+    p->transaction_count = 0;
+    p->first_transaction_id = 0;
+    p->is_regular = false;
+    idmap_put(&pair_ids, pair_key(buyer_index, seller_index), pair_count);
+    pair_count++;
+    return p;
+}
+
+int compare_seller_order(const void *a, const void *b) {
+    int x = sellers[*(const int *)a].seller_id;
+    int y = sellers[*(const int *)b].seller_id;
+    return (x > y) - (x < y);
+}
+
+int compare_buyer_order(const void *a, const void *b) {
+    int x = buyers[*(const int *)a].buyer_id;
+    int y = buyers[*(const int *)b].buyer_id;
+    return (x > y) - (x < y);
+}
+
+// Dense seller indices in ascending seller_id order, re-sorted only after
+// a new seller has been interned
+const int *sellers_in_id_order() {
+    if (seller_order_dirty) {
+        for (int i = 0; i < seller_count; i++) seller_order[i] = i;
+        qsort(seller_order, seller_count, sizeof(int), compare_seller_order);
+        seller_order_dirty = false;
+    }
+    return seller_order;
+}
+
+const int *buyers_in_id_order() {
+    if (buyer_order_dirty) {
+        for (int i = 0; i < buyer_count; i++) buyer_order[i] = i;
+        qsort(buyer_order, buyer_count, sizeof(int), compare_buyer_order);
+        buyer_order_dirty = false;
+    }
+    return buyer_order;
+}
+
+// ---------------------------- Fixed-Point Helpers ----------------------------
+
+// Divides by a positive divisor, rounding half away from zero
+int64_t div_round(int64_t value, int64_t divisor) {
+    if (value >= 0) return (value + divisor / 2) / divisor;
+    return -((-value + divisor / 2) / divisor);
+}
+
+int64_t pow10_i64(int digits) {
+    int64_t p = 1;
+    while (digits-- > 0) p *= 10;
+    return p;
+}
+
+// Converts interactive input to fixed point
+int64_t fixed_from_double(double value, int64_t scale) {
+    double scaled = value * (double)scale;
+    return (int64_t)(scaled >= 0 ? scaled + 0.5 : scaled - 0.5);
+}
+
+// Parses a decimal such as "250.5" or "-0.12" scaled by `scale` (a power
+// of ten), rounding half away from zero on surplus fraction digits.
+// Returns the position after the number, or NULL if there are no digits.
+const char *parse_fixed(const char *p, int64_t scale, int64_t *out) {
+    while (*p == ' ' || *p == '\t') p++;
+
+    bool negative = false;
+    if (*p == '-' || *p == '+') {
+        negative = (*p == '-');
+        p++;
+    }
+
+    int64_t whole = 0;
+    int digits = 0;
+    while (*p >= '0' && *p <= '9') {
+        whole = whole * 10 + (*p++ - '0');
+        digits++;
+    }
+
+    int64_t frac = 0;
+    int64_t place = scale;
+    bool round_up = false;
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') {
+            if (place > 1) {
+                place /= 10;
+                frac += (*p - '0') * place;
+            } else if (place == 1) {
+                round_up = (*p >= '5');
+                place = 0;
+            }
+            p++;
+            digits++;
+        }
+    }
+    if (digits == 0) return NULL;
+
+    int64_t value = whole * scale + frac + (round_up ? 1 : 0);
+    *out = negative ? -value : value;
+    return p;
+}
+
+// Parses a decimal integer; returns the position after it or NULL
+const char *parse_int(const char *p, int *out) {
+    while (*p == ' ' || *p == '\t') p++;
+
+    bool negative = false;
+    if (*p == '-' || *p == '+') {
+        negative = (*p == '-');
+        p++;
+    }
+    if (*p < '0' || *p > '9') return NULL;
+
+    int value = 0;
+    while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (*p++ - '0');
+    }
+    *out = negative ? -value : value;
+    return p;
+}
+
+// Renders a fixed-point value with `decimals` fraction digits
+char *format_fixed(char *buf, size_t size, int64_t value, int64_t scale, int decimals) {
+    int64_t unit = pow10_i64(decimals);
+    int64_t rounded = div_round(value, scale / unit);
+    const char *sign = rounded < 0 ? "-" : "";
+    if (rounded < 0) rounded = -rounded;
+
+    snprintf(buf, size, "%s%lld.%0*lld", sign,
+             (long long)(rounded / unit), decimals, (long long)(rounded % unit));
+    return buf;
+}
+
+char *format_energy(char *buf, energy_t value) {
+    return format_fixed(buf, 32, value, ENERGY_SCALE, 2);
+}
+
+char *format_money(char *buf, money_t value) {
+    return format_fixed(buf, 32, value, MONEY_SCALE, 2);
+}
+
+// energy (milli-kWh) x rate (micro-dollars per kWh) -> micro-dollars
+money_t energy_cost(energy_t energy, money_t rate) {
+    return div_round(energy * rate, ENERGY_SCALE);
+}
+
+// ---------------------------- Cold Storage ----------------------------
+
+int extract_int(const char *str, int start, int len);
+int cold_segment_top_up(ColdSegment *seg, Transaction **rows, int count);
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+int64_t days_from_civil(int64_t year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yoe = year - era * 400;
+    int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void civil_from_days(int64_t days, int *year, int *month, int *day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    *day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (int)(yoe + era * 400 + (*month <= 2));
+}
+
+// Minutes since the epoch for a validated "YYYY-MM-DD HH:MM" string
+int64_t datetime_to_minutes(const char *datetime) {
+    int64_t days = days_from_civil(extract_int(datetime, 0, 4),
+                                   extract_int(datetime, 5, 2),
+                                   extract_int(datetime, 8, 2));
+    return days * MINUTES_PER_DAY + extract_int(datetime, 11, 2) * 60 + extract_int(datetime, 14, 2);
+}
+
+void minutes_to_datetime(int64_t minutes, char datetime[20]) {
+    int64_t days = minutes / MINUTES_PER_DAY;
+    int64_t rem = minutes % MINUTES_PER_DAY;
+    if (rem < 0) {
+        rem += MINUTES_PER_DAY;
+        days--;
+    }
+    int year, month, day;
+    civil_from_days(days, &year, &month, &day);
+    snprintf(datetime, 20, "%04d-%02d-%02d %02d:%02d",
+             year, month, day, (int)(rem / 60), (int)(rem % 60));
+}
+
+// Records a trade's timestamp once it has been added to the hot trees
+void note_hot_timestamp(const Transaction *t) {
+    int64_t ts = datetime_to_minutes(t->datetime);
+    if (ts > latest_timestamp) latest_timestamp = ts;
+    if (ts < oldest_hot_timestamp) oldest_hot_timestamp = ts;
+}
+
+uint64_t zigzag_encode(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+int64_t zigzag_decode(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+size_t put_varint(uint8_t *out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+const uint8_t *get_varint(const uint8_t *in, uint64_t *value) {
+    uint64_t result = 0;
+    int shift = 0;
+    while (*in & 0x80) {
+        result |= (uint64_t)(*in++ & 0x7F) << shift;
+        shift += 7;
+    }
+    *value = result | ((uint64_t)*in++ << shift);
+    return in;
+}
+
+void *checked_malloc(size_t size) {
+    void *p = malloc(size);
+    if (!p && size > 0) {
+        printf("Memory allocation failed for cold segment.\n");
+        exit(1);
+    }
+    return p;
+}
+
+void pack_column(PackedColumn *col, int64_t *values, int count) {
+    int64_t min = values[0], max = values[0];
+    for (int i = 1; i < count; i++) {
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+    }
+
+    uint64_t range = (uint64_t)(max - min);
+    int bits = 0;
+    while (bits < 64 && (range >> bits) != 0) bits++;
+
+    col->base = min;
+    col->bits = bits;
+    size_t words = ((size_t)count * bits + 63) / 64;
+    col->words = (uint64_t *)checked_malloc(words * sizeof(uint64_t));
+    memset(col->words, 0, words * sizeof(uint64_t));
+
+    for (int i = 0; i < count && bits > 0; i++) {
+        uint64_t v = (uint64_t)(values[i] - min);
+        size_t offset = (size_t)i * bits;
+        size_t word = offset >> 6;
+        int shift = (int)(offset & 63);
+        col->words[word] |= v << shift;
+        if (shift + bits > 64) {
+            col->words[word + 1] |= v >> (64 - shift);
+        }
+    }
+}
+
+int64_t packed_get(const PackedColumn *col, int index) {
+    if (col->bits == 0) return col->base;
+
+    size_t offset = (size_t)index * col->bits;
+    size_t word = offset >> 6;
+    int shift = (int)(offset & 63);
+    uint64_t v = col->words[word] >> shift;
+    if (shift + col->bits > 64) {
+        v |= col->words[word + 1] << (64 - shift);
+    }
+    if (col->bits < 64) {
+        v &= (1ULL << col->bits) - 1;
+    }
+    return col->base + (int64_t)v;
+}
+
+size_t packed_bytes(const PackedColumn *col, int count) {
+    return ((size_t)count * col->bits + 63) / 64 * sizeof(uint64_t);
+}
+
+int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Builds a sorted, de-duplicated dictionary from `values`
+int build_int_dict(int *values, int count, int **dict_out) {
+    int *dict = (int *)checked_malloc(count * sizeof(int));
+    memcpy(dict, values, count * sizeof(int));
+    qsort(dict, count, sizeof(int), compare_ints);
+
+    int size = 0;
+    for (int i = 0; i < count; i++) {
+        if (size == 0 || dict[size - 1] != dict[i]) {
+            dict[size++] = dict[i];
+        }
+    }
+    *dict_out = dict;
+    return size;
+}
+
+// Position of value in a sorted dictionary, or -1
+int dict_lookup(const int *dict, int size, int value) {
+    int lo = 0, hi = size - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (dict[mid] == value) return mid;
+        if (dict[mid] < value) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+// Encodes `count` trades, already sorted by transaction_id, into a segment
+void encode_cold_segment(ColdSegment *seg, Transaction **rows, int count) {
+    if (count <= 0) return;
+
+    int64_t *values = (int64_t *)checked_malloc(count * sizeof(int64_t));
+    int *indices = (int *)checked_malloc(count * sizeof(int));
+    int64_t *timestamps = (int64_t *)checked_malloc(count * sizeof(int64_t));
+
+    seg->row_count = count;
+    seg->min_transaction_id = rows[0]->transaction_id;
+    seg->max_transaction_id = rows[count - 1]->transaction_id;
+
+    // Ids and timestamps: varint deltas
+    uint8_t *id_buf = (uint8_t *)checked_malloc((size_t)count * 10);
+    uint8_t *ts_buf = (uint8_t *)checked_malloc((size_t)count * 10);
+    size_t id_len = 0, ts_len = 0;
+    int64_t prev_id = 0, prev_ts = 0;
+    for (int i = 0; i < count; i++) {
+        int64_t id = rows[i]->transaction_id;
+        timestamps[i] = datetime_to_minutes(rows[i]->datetime);
+        id_len += put_varint(id_buf + id_len, i == 0 ? zigzag_encode(id) : (uint64_t)(id - prev_id));
+        ts_len += put_varint(ts_buf + ts_len, zigzag_encode(timestamps[i] - prev_ts));
+        prev_id = id;
+        prev_ts = timestamps[i];
+    }
+    seg->id_deltas = (uint8_t *)realloc(id_buf, id_len);
+    seg->timestamp_deltas = (uint8_t *)realloc(ts_buf, ts_len);
+    seg->id_bytes = id_len;
+    seg->timestamp_bytes = ts_len;
+
+    seg->min_timestamp = seg->max_timestamp = timestamps[0];
+    for (int i = 1; i < count; i++) {
+        if (timestamps[i] < seg->min_timestamp) seg->min_timestamp = timestamps[i];
+        if (timestamps[i] > seg->max_timestamp) seg->max_timestamp = timestamps[i];
+    }
+
+    // Participants: dictionary of dense indices plus bit-packed codes
+    for (int i = 0; i < count; i++) indices[i] = find_buyer_index(rows[i]->buyer_id);
+    seg->buyer_dict_size = build_int_dict(indices, count, &seg->buyer_dict);
+    for (int i = 0; i < count; i++) {
+        values[i] = dict_lookup(seg->buyer_dict, seg->buyer_dict_size, indices[i]);
+    }
+    pack_column(&seg->buyer_codes, values, count);
+
+    for (int i = 0; i < count; i++) indices[i] = find_seller_index(rows[i]->seller_id);
+    seg->seller_dict_size = build_int_dict(indices, count, &seg->seller_dict);
+    for (int i = 0; i < count; i++) {
+        values[i] = dict_lookup(seg->seller_dict, seg->seller_dict_size, indices[i]);
+    }
+    pack_column(&seg->seller_codes, values, count);
+
+    // Rate pairs rarely change, so a linear dictionary stays tiny
+    seg->rate_dict = (money_t *)checked_malloc((size_t)count * 2 * sizeof(money_t));
+    seg->rate_dict_size = 0;
+    for (int i = 0; i < count; i++) {
+        int code = -1;
+        for (int r = 0; r < seg->rate_dict_size; r++) {
+            if (seg->rate_dict[2 * r] == rows[i]->rate_below_300 &&
+                seg->rate_dict[2 * r + 1] == rows[i]->rate_above_300) {
+                code = r;
+                break;
+            }
+        }
+        if (code < 0) {
+            code = seg->rate_dict_size++;
+            seg->rate_dict[2 * code] = rows[i]->rate_below_300;
+            seg->rate_dict[2 * code + 1] = rows[i]->rate_above_300;
+        }
+        values[i] = code;
+    }
+    seg->rate_dict = (money_t *)realloc(seg->rate_dict, seg->rate_dict_size * 2 * sizeof(money_t));
+    pack_column(&seg->rate_codes, values, count);
+
+    for (int i = 0; i < count; i++) values[i] = rows[i]->energy_kwh;
+    pack_column(&seg->energy, values, count);
+    seg->min_energy = seg->energy.base;
+    seg->max_energy = seg->energy.base;
+    for (int i = 0; i < count; i++) {
+        if (values[i] > seg->max_energy) seg->max_energy = values[i];
+    }
+
+    for (int i = 0; i < count; i++) values[i] = rows[i]->price_per_kwh;
+    pack_column(&seg->price_per_kwh, values, count);
+    for (int i = 0; i < count; i++) values[i] = rows[i]->total_price;
+    pack_column(&seg->total_price, values, count);
+
+    free(values);
+    free(indices);
+    free(timestamps);
+}
+
+size_t cold_segment_bytes(const ColdSegment *seg) {
+    return sizeof(ColdSegment) + seg->id_bytes + seg->timestamp_bytes +
+           (seg->buyer_dict_size + seg->seller_dict_size) * sizeof(int) +
+           seg->rate_dict_size * 2 * sizeof(money_t) +
+           packed_bytes(&seg->buyer_codes, seg->row_count) +
+           packed_bytes(&seg->seller_codes, seg->row_count) +
+           packed_bytes(&seg->rate_codes, seg->row_count) +
+           packed_bytes(&seg->energy, seg->row_count) +
+           packed_bytes(&seg->price_per_kwh, seg->row_count) +
+           packed_bytes(&seg->total_price, seg->row_count);
+}
+
+void free_cold_segment(ColdSegment *seg) {
+    free(seg->id_deltas);
+    free(seg->timestamp_deltas);
+    free(seg->buyer_dict);
+    free(seg->seller_dict);
+    free(seg->rate_dict);
+    free(seg->buyer_codes.words);
+    free(seg->seller_codes.words);
+    free(seg->rate_codes.words);
+    free(seg->energy.words);
+    free(seg->price_per_kwh.words);
+    free(seg->total_price.words);
+}
+
+void free_tree_nodes(node *root) {
+    if (root == NULL) return;
+    if (!root->is_leaf) {
+        for (int i = 0; i <= root->num_keys; i++) {
+            free_tree_nodes((node *)root->pointers[i]);
+        }
+    }
+    free(root->pointers);
+    free(root->keys);
+    free(root);
+}
+
+// Moves every hot trade older than the cold-storage cutoff into sealed
+// segments and rebuilds the hot trees from what is left.
+void seal_cold_transactions() {
+    hot_inserts_since_seal = 0;
+    if (!tiered_storage || transaction_index == 0) return;
+
+    int64_t cutoff = latest_timestamp - (int64_t)COLD_STORAGE_AGE_DAYS * MINUTES_PER_DAY;
+    if (oldest_hot_timestamp >= cutoff) return;
+
+    Transaction **cold = (Transaction **)checked_malloc(transaction_index * sizeof(Transaction *));
+    Transaction **hot = (Transaction **)checked_malloc(transaction_index * sizeof(Transaction *));
+    int cold_count = 0, hot_count = 0;
+    oldest_hot_timestamp = INT64_MAX;
+
+    // The leaf chain yields trades in transaction_id order
+    node *leaf = find_leftmost_leaf(global_transaction_tree);
+    while (leaf) {
+        for (int i = 0; i < leaf->num_keys; i++) {
+            Transaction *t = (Transaction *)leaf->pointers[i];
+            int64_t ts = datetime_to_minutes(t->datetime);
+            if (ts < cutoff) {
+                cold[cold_count++] = t;
+            } else {
+                hot[hot_count++] = t;
+                if (ts < oldest_hot_timestamp) oldest_hot_timestamp = ts;
+            }
+        }
+        leaf = leaf->next;
+    }
+
+    // Seals that each age out a few trades would otherwise leave a trail of
+    // small segments, every one of them opened by each cursor
+    int start = 0;
+    if (cold_count > 0 && cold_segment_count > 0 &&
+        cold_segments[cold_segment_count - 1].row_count < COLD_SEGMENT_ROWS) {
+        start = cold_segment_top_up(&cold_segments[cold_segment_count - 1], cold, cold_count);
+    }
+    for (; start < cold_count; start += COLD_SEGMENT_ROWS) {
+        int rows = cold_count - start < COLD_SEGMENT_ROWS ? cold_count - start : COLD_SEGMENT_ROWS;
+        cold_segments = (ColdSegment *)grow_array(cold_segments, &cold_segment_capacity,
+                                                  cold_segment_count + 1, sizeof(ColdSegment));
+        encode_cold_segment(&cold_segments[cold_segment_count++], cold + start, rows);
+    }
+    cold_row_count += cold_count;
+
+    // Rebuild the hot trees without the sealed trades
+    free_tree_nodes(global_transaction_tree);
+    global_transaction_tree = NULL;
+    for (int i = 0; i < seller_count; i++) {
+        free_tree_nodes(sellers[i].transaction_tree);
+        sellers[i].transaction_tree = NULL;
+    }
+    for (int i = 0; i < buyer_count; i++) {
+        free_tree_nodes(buyers[i].transaction_tree);
+        buyers[i].transaction_tree = NULL;
+    }
+    free_time_nodes(seller_time_index);
+    free_time_nodes(buyer_time_index);
+    seller_time_index = NULL;
+    buyer_time_index = NULL;
+    for (int i = 0; i < hot_count; i++) {
+        Transaction *t = hot[i];
+        SellerKey *s = &sellers[find_seller_index(t->seller_id)];
+        BuyerKey *b = &buyers[find_buyer_index(t->buyer_id)];
+        global_transaction_tree = insert_transaction(global_transaction_tree, t);
+        s->transaction_tree = insert_transaction(s->transaction_tree, t);
+        b->transaction_tree = insert_transaction(b->transaction_tree, t);
+        index_trade_times(t, datetime_to_minutes(t->datetime), (int)(s - sellers), (int)(b - buyers));
+        all_transactions[i] = t;
+    }
+    transaction_index = hot_count;
+
+    for (int i = 0; i < cold_count; i++) {
+        SellerKey *s = &sellers[find_seller_index(cold[i]->seller_id)];
+        s->sealed_revenue += cold[i]->total_price;
+        s->sealed_energy += cold[i]->energy_kwh;
+        free(cold[i]);
+    }
+    free(cold);
+    free(hot);
+}
+
+// Called after each hot insert; seals in batches so the trees are not
+// rebuilt on every trade
+void maybe_seal_cold_transactions() {
+    if (++hot_inserts_since_seal >= COLD_SEAL_BATCH) {
+        seal_cold_transactions();
+    }
+}
+
+void print_storage_stats() {
+    size_t cold_bytes = 0;
+    for (int i = 0; i < cold_segment_count; i++) {
+        cold_bytes += cold_segment_bytes(&cold_segments[i]);
+    }
+    printf("Storage: %d hot transactions, %d sealed in %d cold segments (%zu bytes, %.1f bytes/row)\n",
+           transaction_index, cold_row_count, cold_segment_count, cold_bytes,
+           cold_row_count ? (double)cold_bytes / cold_row_count : 0.0);
+}
+
+// Decodes the randomly addressable columns of `row` into `t`; the id and
+// timestamp come from a sequential walk of the deltas.
+void cold_row_fill(const ColdSegment *seg, int row, int64_t timestamp, Transaction *t) {
+    t->buyer_id = buyers[seg->buyer_dict[packed_get(&seg->buyer_codes, row)]].buyer_id;
+    t->seller_id = sellers[seg->seller_dict[packed_get(&seg->seller_codes, row)]].seller_id;
+    t->energy_kwh = packed_get(&seg->energy, row);
+    t->price_per_kwh = packed_get(&seg->price_per_kwh, row);
+    t->total_price = packed_get(&seg->total_price, row);
+    int rate = (int)packed_get(&seg->rate_codes, row);
+    t->rate_below_300 = seg->rate_dict[2 * rate];
+    t->rate_above_300 = seg->rate_dict[2 * rate + 1];
+    minutes_to_datetime(timestamp, t->datetime);
+}
+
+// Loads the next row of the segment that passes the cursor filter.
+// Returns false once the segment is exhausted.
+bool segment_cursor_next(SegmentCursor *sc, const TransactionFilter *f) {
+    const ColdSegment *seg = sc->segment;
+    while (++sc->row < seg->row_count) {
+        uint64_t raw;
+        sc->id_pos = get_varint(sc->id_pos, &raw);
+        int id = sc->row == 0 ? (int)zigzag_decode(raw) : sc->current.transaction_id + (int)raw;
+        sc->current.transaction_id = id;
+        sc->timestamp_pos = get_varint(sc->timestamp_pos, &raw);
+        sc->timestamp += zigzag_decode(raw);
+
+        int row = sc->row;
+        if (sc->seller_code >= 0 && packed_get(&seg->seller_codes, row) != sc->seller_code) continue;
+        if (sc->buyer_code >= 0 && packed_get(&seg->buyer_codes, row) != sc->buyer_code) continue;
+        if (sc->timestamp < f->min_timestamp || sc->timestamp > f->max_timestamp) continue;
+
+        energy_t energy = packed_get(&seg->energy, row);
+        if (energy < f->min_energy || energy > f->max_energy) continue;
+
+        cold_row_fill(seg, row, sc->timestamp, &sc->current);
+        return true;
+    }
+    return false;
+}
+
+void segment_cursor_init(SegmentCursor *sc, const ColdSegment *seg) {
+    sc->segment = seg;
+    sc->row = -1;
+    sc->id_pos = seg->id_deltas;
+    sc->timestamp_pos = seg->timestamp_deltas;
+    sc->timestamp = 0;
+    sc->seller_code = -1;
+    sc->buyer_code = -1;
+    sc->current.transaction_id = 0;
+}
+
+void cursor_sift_down(TransactionCursor *c, int i) {
+    for (;;) {
+        int smallest = i;
+        int l = 2 * i + 1, r = 2 * i + 2;
+        if (l < c->heap_size &&
+            c->heap[l].current.transaction_id < c->heap[smallest].current.transaction_id) smallest = l;
+        if (r < c->heap_size &&
+            c->heap[r].current.transaction_id < c->heap[smallest].current.transaction_id) smallest = r;
+        if (smallest == i) return;
+        SegmentCursor tmp = c->heap[i];
+        c->heap[i] = c->heap[smallest];
+        c->heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+TransactionFilter no_filter() {
+    TransactionFilter f = { -1, -1, INT64_MIN, INT64_MAX, INT64_MIN, INT64_MAX };
+    return f;
+}
+
+// Opens a cursor over `hot_tree` plus every cold row matching `filter`,
+// skipping segments whose zone maps or dictionaries rule them out
+void cursor_open(TransactionCursor *c, node *hot_tree, TransactionFilter filter) {
+    c->leaf = find_leftmost_leaf(hot_tree);
+    c->slot = 0;
+    c->filter = filter;
+    c->advance_top = false;
+    c->refs = NULL;
+    c->ref_count = 0;
+    c->heap_size = 0;
+    c->heap = cold_segment_count ?
+        (SegmentCursor *)checked_malloc(cold_segment_count * sizeof(SegmentCursor)) : NULL;
+
+    for (int i = 0; i < cold_segment_count; i++) {
+        const ColdSegment *seg = &cold_segments[i];
+        if (seg->max_timestamp < filter.min_timestamp || seg->min_timestamp > filter.max_timestamp) continue;
+        if (seg->max_energy < filter.min_energy || seg->min_energy > filter.max_energy) continue;
+
+        SegmentCursor sc;
+        segment_cursor_init(&sc, seg);
+        if (filter.seller_index >= 0) {
+            sc.seller_code = dict_lookup(seg->seller_dict, seg->seller_dict_size, filter.seller_index);
+            if (sc.seller_code < 0) continue;
+        }
+        if (filter.buyer_index >= 0) {
+            sc.buyer_code = dict_lookup(seg->buyer_dict, seg->buyer_dict_size, filter.buyer_index);
+            if (sc.buyer_code < 0) continue;
+        }
+        if (segment_cursor_next(&sc, &filter)) {
+            c->heap[c->heap_size++] = sc;
+        }
+    }
+    for (int i = c->heap_size / 2 - 1; i >= 0; i--) {
+        cursor_sift_down(c, i);
+    }
+}
+
+// Next trade in transaction_id order, or NULL. Cold rows are decoded into
+// cursor-owned storage that is only valid until the following call.
+const Transaction *cursor_next(TransactionCursor *c) {
+    if (c->advance_top) {
+        c->advance_top = false;
+        if (!segment_cursor_next(&c->heap[0], &c->filter)) {
+            c->heap[0] = c->heap[--c->heap_size];
+        }
+        cursor_sift_down(c, 0);
+    }
+
+    while (c->leaf && c->slot >= c->leaf->num_keys) {
+        c->leaf = c->leaf->next;
+        c->slot = 0;
+    }
+    Transaction *hot = c->leaf ? (Transaction *)c->leaf->pointers[c->slot] : NULL;
+
+    if (c->ref_count > 0 && (hot == NULL || c->refs->transaction_id < hot->transaction_id)) {
+        cold_row_fill(&cold_segments[c->refs->segment], c->refs->row, c->refs->timestamp, &c->ref_row);
+        c->ref_row.transaction_id = c->refs->transaction_id;
+        c->refs++;
+        c->ref_count--;
+        return &c->ref_row;
+    }
+    if (c->heap_size > 0 && (hot == NULL || c->heap[0].current.transaction_id < hot->transaction_id)) {
+        c->advance_top = true;
+        return &c->heap[0].current;
+    }
+    if (hot) c->slot++;
+    return hot;
+}
+
+void cursor_close(TransactionCursor *c) {
+    free(c->heap);
+    c->heap = NULL;
+}
+
+// Opens a cursor over `hot_tree` plus the cold rows `refs`, which must be
+// in transaction_id order (one group of a ColdRowIndex)
+void cursor_open_refs(TransactionCursor *c, node *hot_tree, const ColdRowRef *refs, int count) {
+    c->leaf = find_leftmost_leaf(hot_tree);
+    c->slot = 0;
+    c->filter = no_filter();
+    c->advance_top = false;
+    c->heap = NULL;
+    c->heap_size = 0;
+    c->refs = refs;
+    c->ref_count = count;
+}
+
+int compare_cold_refs(const void *a, const void *b) {
+    int x = ((const ColdRowRef *)a)->transaction_id, y = ((const ColdRowRef *)b)->transaction_id;
+    return (x > y) - (x < y);
+}
+
+// Groups every sealed row by seller (or buyer) in one pass over the
+// segments, so a report covering every participant decodes each row once
+// rather than once per participant whose dictionary it appears in.
+void cold_index_build(ColdRowIndex *ix, bool by_seller) {
+    int participants = by_seller ? seller_count : buyer_count;
+    ix->starts = (int *)checked_malloc((participants + 1) * sizeof(int));
+    ix->refs = (ColdRowRef *)checked_malloc((cold_row_count + 1) * sizeof(ColdRowRef));
+    memset(ix->starts, 0, (participants + 1) * sizeof(int));
+
+    for (int i = 0; i < cold_segment_count; i++) {
+        const ColdSegment *seg = &cold_segments[i];
+        const PackedColumn *codes = by_seller ? &seg->seller_codes : &seg->buyer_codes;
+        const int *dict = by_seller ? seg->seller_dict : seg->buyer_dict;
+        for (int row = 0; row < seg->row_count; row++) {
+            ix->starts[dict[packed_get(codes, row)] + 1]++;
+        }
+    }
+    for (int p = 0; p < participants; p++) ix->starts[p + 1] += ix->starts[p];
+
+    int *fill = (int *)checked_malloc((participants + 1) * sizeof(int));
+    memcpy(fill, ix->starts, (participants + 1) * sizeof(int));
+    for (int i = 0; i < cold_segment_count; i++) {
+        const ColdSegment *seg = &cold_segments[i];
+        const PackedColumn *codes = by_seller ? &seg->seller_codes : &seg->buyer_codes;
+        const int *dict = by_seller ? seg->seller_dict : seg->buyer_dict;
+        const uint8_t *id_pos = seg->id_deltas, *timestamp_pos = seg->timestamp_deltas;
+        int id = 0;
+        int64_t timestamp = 0;
+        for (int row = 0; row < seg->row_count; row++) {
+            uint64_t raw;
+            id_pos = get_varint(id_pos, &raw);
+            id = row == 0 ? (int)zigzag_decode(raw) : id + (int)raw;
+            timestamp_pos = get_varint(timestamp_pos, &raw);
+            timestamp += zigzag_decode(raw);
+
+            ColdRowRef *ref = &ix->refs[fill[dict[packed_get(codes, row)]]++];
+            ref->transaction_id = id;
+            ref->segment = i;
+            ref->row = row;
+            ref->timestamp = timestamp;
+        }
+    }
+    free(fill);
+
+    // Each segment is in id order, but id ranges of segments can overlap
+    for (int p = 0; p < participants; p++) {
+        ColdRowRef *group = ix->refs + ix->starts[p];
+        int count = ix->starts[p + 1] - ix->starts[p];
+        for (int i = 1; i < count; i++) {
+            if (group[i].transaction_id < group[i - 1].transaction_id) {
+                qsort(group, count, sizeof(ColdRowRef), compare_cold_refs);
+                break;
+            }
+        }
+    }
+}
+
+void cold_index_free(ColdRowIndex *ix) {
+    free(ix->starts);
+    free(ix->refs);
+}
+
+// Re-encodes `seg` with as many of `rows` (sorted by transaction_id) as fit
+// under COLD_SEGMENT_ROWS; returns how many were taken
+int cold_segment_top_up(ColdSegment *seg, Transaction **rows, int count) {
+    int take = COLD_SEGMENT_ROWS - seg->row_count;
+    if (take > count) take = count;
+    int total = seg->row_count + take;
+
+    Transaction *existing = (Transaction *)checked_malloc(seg->row_count * sizeof(Transaction));
+    Transaction **merged = (Transaction **)checked_malloc(total * sizeof(Transaction *));
+    TransactionFilter filter = no_filter();
+    SegmentCursor sc;
+    segment_cursor_init(&sc, seg);
+    for (int i = 0; segment_cursor_next(&sc, &filter); i++) existing[i] = sc.current;
+
+    int a = 0, b = 0;
+    for (int i = 0; i < total; i++) {
+        if (b == take || (a < seg->row_count && existing[a].transaction_id < rows[b]->transaction_id)) {
+            merged[i] = &existing[a++];
+        } else {
+            merged[i] = rows[b++];
+        }
+    }
+    free_cold_segment(seg);
+    encode_cold_segment(seg, merged, total);
+    free(existing);
+    free(merged);
+    return take;
+}
+
+// ---------------------------- Transaction Id Set ----------------------------
+
+// Exact membership set over every transaction id ever accepted, hot or
+// sealed, so duplicate checks never walk a tree. Roaring-style: ids are
+// bucketed by their high 16 bits, and each bucket holds the low 16 bits
+// as a sorted array until it passes ID_ARRAY_MAX entries, then as a bitmap.
+
+int id_container_search(const IdContainer *c, uint16_t low) {
+    int lo = 0, hi = c->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (c->values[mid] < low) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+bool idset_contains(const IdSet *set, int id) {
+    uint32_t key = (uint32_t)id;
+    int index = idmap_find(&set->directory, key >> 16);
+    if (index < 0) return false;
+
+    const IdContainer *c = &set->containers[index];
+    uint16_t low = (uint16_t)key;
+    if (c->bits) {
+        return (c->bits[low >> 6] >> (low & 63)) & 1;
+    }
+    int pos = id_container_search(c, low);
+    return pos < c->count && c->values[pos] == low;
+}
+
+void id_container_to_bitmap(IdContainer *c) {
+    c->bits = (uint64_t *)calloc(ID_BITMAP_WORDS, sizeof(uint64_t));
+    if (!c->bits) {
+        printf("Memory allocation failed for id set.\n");
+        exit(1);
+    }
+    for (int i = 0; i < c->count; i++) {
+        c->bits[c->values[i] >> 6] |= (uint64_t)1 << (c->values[i] & 63);
+    }
+    free(c->values);
+    c->values = NULL;
+    c->capacity = 0;
+}
+
+// Adds an id; returns false if it was already present
+bool idset_add(IdSet *set, int id) {
+    uint32_t key = (uint32_t)id;
+    int index = idmap_find(&set->directory, key >> 16);
+    if (index < 0) {
+        set->containers = (IdContainer *)grow_array(set->containers, &set->container_capacity,
+                                                    set->container_count + 1, sizeof(IdContainer));
+        index = set->container_count++;
+        memset(&set->containers[index], 0, sizeof(IdContainer));
+        set->containers[index].high = key >> 16;
+        idmap_put(&set->directory, key >> 16, index);
+    }
+
+    IdContainer *c = &set->containers[index];
+    uint16_t low = (uint16_t)key;
+    if (c->bits) {
+        uint64_t mask = (uint64_t)1 << (low & 63);
+        if (c->bits[low >> 6] & mask) return false;
+        c->bits[low >> 6] |= mask;
+        c->count++;
+        set->count++;
+        return true;
+    }
+
+    int pos = id_container_search(c, low);
+    if (pos < c->count && c->values[pos] == low) return false;
+    c->values = (uint16_t *)grow_array(c->values, &c->capacity, c->count + 1, sizeof(uint16_t));
+    memmove(&c->values[pos + 1], &c->values[pos], (c->count - pos) * sizeof(uint16_t));
+    c->values[pos] = low;
+    c->count++;
+    set->count++;
+    if (c->count > ID_ARRAY_MAX) {
+        id_container_to_bitmap(c);
+    }
+    return true;
+}
+
+// Snapshot layout: container count, then per container its high 16 bits,
+// entry count and either the sorted low halves or the full bitmap
+bool idset_write(const IdSet *set, FILE *file) {
+    if (fwrite(&set->container_count, sizeof(int), 1, file) != 1) return false;
+    for (int i = 0; i < set->container_count; i++) {
+        const IdContainer *c = &set->containers[i];
+        if (fwrite(&c->high, sizeof(c->high), 1, file) != 1) return false;
+        if (fwrite(&c->count, sizeof(int), 1, file) != 1) return false;
+        if (c->bits) {
+            if (fwrite(c->bits, sizeof(uint64_t), ID_BITMAP_WORDS, file) != ID_BITMAP_WORDS) return false;
+        } else if (c->count > 0) {
+            if (fwrite(c->values, sizeof(uint16_t), c->count, file) != (size_t)c->count) return false;
+        }
+    }
+    return true;
+}
+
+bool idset_read(IdSet *set, FILE *file) {
+    int container_count;
+    if (fread(&container_count, sizeof(int), 1, file) != 1 || container_count < 0) return false;
+    for (int i = 0; i < container_count; i++) {
+        uint32_t high;
+        int count;
+        if (fread(&high, sizeof(high), 1, file) != 1) return false;
+        if (fread(&count, sizeof(int), 1, file) != 1) return false;
+        if (count < 0 || count > 65536) return false;
+
+        set->containers = (IdContainer *)grow_array(set->containers, &set->container_capacity,
+                                                    set->container_count + 1, sizeof(IdContainer));
+        IdContainer *c = &set->containers[set->container_count];
+        memset(c, 0, sizeof(IdContainer));
+        c->high = high;
+        idmap_put(&set->directory, high, set->container_count++);
+        c->count = count;
+        set->count += count;
+        if (count > ID_ARRAY_MAX) {
+            c->bits = (uint64_t *)checked_malloc(ID_BITMAP_WORDS * sizeof(uint64_t));
+            if (fread(c->bits, sizeof(uint64_t), ID_BITMAP_WORDS, file) != ID_BITMAP_WORDS) return false;
+        } else if (count > 0) {
+            c->capacity = count;
+            c->values = (uint16_t *)checked_malloc(count * sizeof(uint16_t));
+            if (fread(c->values, sizeof(uint16_t), count, file) != (size_t)count) return false;
+        }
+    }
+    return true;
+}
+
+// ---------------------------- Report Output ----------------------------
+
+// Rows are formatted straight into a ReportBuffer with the put_* helpers
+// below instead of printf, and buffers go out with one write() each.
+
+static const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+char *put_uint(char *p, uint64_t v) {
+    char tmp[20];
+    char *end = tmp + sizeof(tmp);
+    char *q = end;
+    while (v >= 100) {
+        int pair = (int)(v % 100) * 2;
+        v /= 100;
+        *--q = digit_pairs[pair + 1];
+        *--q = digit_pairs[pair];
+    }
+    if (v >= 10) {
+        *--q = digit_pairs[v * 2 + 1];
+        *--q = digit_pairs[v * 2];
+    } else {
+        *--q = (char)('0' + v);
+    }
+    memcpy(p, q, end - q);
+    return p + (end - q);
+}
+
+char *put_int(char *p, int64_t v) {
+    if (v < 0) {
+        *p++ = '-';
+        return put_uint(p, (uint64_t)0 - (uint64_t)v);
+    }
+    return put_uint(p, (uint64_t)v);
+}
+
+// Same text as format_fixed(): rounded to `decimals` fraction digits
+char *put_fixed(char *p, int64_t value, int64_t scale, int decimals) {
+    int64_t unit = pow10_i64(decimals);
+    int64_t rounded = div_round(value, scale / unit);
+    if (rounded < 0) {
+        *p++ = '-';
+        rounded = -rounded;
+    }
+    p = put_uint(p, (uint64_t)(rounded / unit));
+    *p++ = '.';
+    int64_t frac = rounded % unit;
+    for (int64_t place = unit / 10; place > 0; place /= 10) {
+        *p++ = (char)('0' + frac / place % 10);
+    }
+    return p;
+}
+
+// Renders a fixed-point value exactly: every significant digit, at least
+// `min_decimals` of them after the point, so values written by older builds
+// read back unchanged
+char *put_fixed_exact(char *p, int64_t value, int64_t scale, int min_decimals) {
+    int decimals = 0;
+    while (pow10_i64(decimals) < scale) decimals++;
+    p = put_fixed(p, value, scale, decimals);
+    while (decimals > min_decimals && p[-1] == '0') {
+        p--;
+        decimals--;
+    }
+    return p;
+}
+
+char *put_str(char *p, const char *s) {
+    size_t n = strlen(s);
+    memcpy(p, s, n);
+    return p + n;
+}
+
+// Left-aligns the field that began at `start` in `width` columns, like %-Ns
+char *pad_to(char *start, char *p, int width) {
+    while (p - start < width) *p++ = ' ';
+    return p;
+}
+
+// Makes room for `needed` more bytes and returns where they go
+char *report_reserve(ReportBuffer *out, size_t needed) {
+    if (out->capacity - out->length < needed) {
+        size_t capacity = out->capacity ? out->capacity : 4096;
+        while (capacity - out->length < needed) capacity *= 2;
+        char *grown = (char *)realloc(out->data, capacity);
+        if (!grown) {
+            printf("Memory allocation failed for report buffer.\n");
+            exit(1);
+        }
+        out->data = grown;
+        out->capacity = capacity;
+    }
+    return out->data + out->length;
+}
+
+void report_commit(ReportBuffer *out, char *end) {
+    out->length = end - out->data;
+}
+
+// "%-5d %-8d %-8d %-12s %-12s %-12s[ %s]\n" for the global listings
+void report_transaction_row(ReportBuffer *out, const Transaction *t, bool with_time) {
+    char *p = report_reserve(out, REPORT_MAX_ROW_BYTES);
+    char *f = p;
+    p = pad_to(f, put_int(p, t->transaction_id), 5); *p++ = ' '; f = p;
+    p = pad_to(f, put_int(p, t->buyer_id), 8); *p++ = ' '; f = p;
+    p = pad_to(f, put_int(p, t->seller_id), 8); *p++ = ' '; f = p;
+    p = pad_to(f, put_fixed(p, t->energy_kwh, ENERGY_SCALE, 2), 12); *p++ = ' '; f = p;
+    p = pad_to(f, put_fixed(p, t->price_per_kwh, MONEY_SCALE, 2), 12); *p++ = ' '; f = p;
+    p = pad_to(f, put_fixed(p, t->total_price, MONEY_SCALE, 2), 12);
+    if (with_time) {
+        *p++ = ' ';
+        p = put_str(p, t->datetime);
+    }
+    *p++ = '\n';
+    report_commit(out, p);
+}
+
+// One row in the same CSV layout as TRANSACTIONS_FILE
+char *put_csv_row(char *p, const Transaction *t) {
+    p = put_int(p, t->transaction_id); *p++ = ',';
+    p = put_int(p, t->buyer_id); *p++ = ',';
+    p = put_int(p, t->seller_id); *p++ = ',';
+    p = put_fixed_exact(p, t->energy_kwh, ENERGY_SCALE, 2); *p++ = ',';
+    p = put_fixed_exact(p, t->rate_below_300, MONEY_SCALE, 2); *p++ = ',';
+    p = put_fixed_exact(p, t->rate_above_300, MONEY_SCALE, 2); *p++ = ',';
+    p = put_str(p, t->datetime);
+    *p++ = '\n';
+    return p;
+}
+
+char *put_json_row(char *p, const Transaction *t) {
+    p = put_str(p, "{\"transaction_id\":"); p = put_int(p, t->transaction_id);
+    p = put_str(p, ",\"buyer_id\":"); p = put_int(p, t->buyer_id);
+    p = put_str(p, ",\"seller_id\":"); p = put_int(p, t->seller_id);
+    p = put_str(p, ",\"energy_kwh\":"); p = put_fixed_exact(p, t->energy_kwh, ENERGY_SCALE, 2);
+    p = put_str(p, ",\"price_per_kwh\":"); p = put_fixed_exact(p, t->price_per_kwh, MONEY_SCALE, 2);
+    p = put_str(p, ",\"total_price\":"); p = put_fixed_exact(p, t->total_price, MONEY_SCALE, 2);
+    p = put_str(p, ",\"rate_below_300\":"); p = put_fixed_exact(p, t->rate_below_300, MONEY_SCALE, 2);
+    p = put_str(p, ",\"rate_above_300\":"); p = put_fixed_exact(p, t->rate_above_300, MONEY_SCALE, 2);
+    p = put_str(p, ",\"datetime\":\""); p = put_str(p, t->datetime);
+    p = put_str(p, "\"}\n");
+    return p;
+}
+
+char *put_le(char *p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        *p++ = (char)(v >> (8 * i));
+    }
+    return p;
+}
+
+// Binary export record, all little-endian (BINARY_RECORD_BYTES long):
+// int32 transaction_id, buyer_id, seller_id, reserved; int64 energy
+// (milli-kWh), price_per_kwh, total_price, rate_below_300, rate_above_300
+// (micro-dollars) and timestamp (minutes since 1970-01-01 00:00).
+char *put_binary_row(char *p, const Transaction *t) {
+    p = put_le(p, (uint32_t)t->transaction_id, 4);
+    p = put_le(p, (uint32_t)t->buyer_id, 4);
+    p = put_le(p, (uint32_t)t->seller_id, 4);
+    p = put_le(p, 0, 4);
+    p = put_le(p, (uint64_t)t->energy_kwh, 8);
+    p = put_le(p, (uint64_t)t->price_per_kwh, 8);
+    p = put_le(p, (uint64_t)t->total_price, 8);
+    p = put_le(p, (uint64_t)t->rate_below_300, 8);
+    p = put_le(p, (uint64_t)t->rate_above_300, 8);
+    p = put_le(p, (uint64_t)datetime_to_minutes(t->datetime), 8);
+    return p;
+}
+
+bool write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+// Sends a finished buffer to stdout in one write(), after anything
+// already queued in stdio
+void report_send(const char *data, size_t length) {
+    fflush(stdout);
+    write_all(STDOUT_FILENO, data, length);
+}
+
+// Streams rows to a file descriptor through one reusable buffer
+void report_writer_open(ReportWriter *w, int fd) {
+    w->fd = fd;
+    w->failed = false;
+    w->buf.data = NULL;
+    w->buf.length = 0;
+    w->buf.capacity = 0;
+    report_reserve(&w->buf, REPORT_WRITE_BUFFER_BYTES);
+}
+
+void report_writer_flush(ReportWriter *w) {
+    if (w->buf.length == 0) return;
+    if (w->fd == STDOUT_FILENO) fflush(stdout);
+    if (!write_all(w->fd, w->buf.data, w->buf.length)) w->failed = true;
+    w->buf.length = 0;
+}
+
+// Call after each row; writes the buffer out once it is nearly full
+void report_writer_row_done(ReportWriter *w) {
+    if (w->buf.capacity - w->buf.length < REPORT_MAX_ROW_BYTES) {
+        report_writer_flush(w);
+    }
+}
+
+void report_writer_close(ReportWriter *w) {
+    report_writer_flush(w);
+    free(w->buf.data);
+    w->buf.data = NULL;
+}
+
+// ---------------------------- Report Cache ----------------------------
+
+void report_printf(ReportBuffer *out, const char *format, ...) {
+    va_list args;
+    for (;;) {
+        size_t room = out->capacity - out->length;
+        va_start(args, format);
+        int needed = vsnprintf(out->data ? out->data + out->length : NULL, room, format, args);
+        va_end(args);
+        if (needed < 0) return;
+        if ((size_t)needed < room) {
+            out->length += needed;
+            return;
+        }
+
+        size_t capacity = out->capacity ? out->capacity * 2 : 4096;
+        while (capacity - out->length <= (size_t)needed) capacity *= 2;
+        char *grown = (char *)realloc(out->data, capacity);
+        if (!grown) {
+            printf("Memory allocation failed for report buffer.\n");
+            exit(1);
+        }
+        out->data = grown;
+        out->capacity = capacity;
+    }
+}
+
+void report_append(ReportBuffer *out, const char *text, size_t length) {
+    memcpy(report_reserve(out, length), text, length);
+    out->length += length;
+}
+
+// Prints an uncached report and releases its buffer
+void report_write(ReportBuffer *out) {
+    if (out->length > 0) {
+        report_send(out->data, out->length);
+    }
+    free(out->data);
+}
+
+bool report_keys_equal(const ReportKey *a, const ReportKey *b) {
+    return a->kind == b->kind && a->low == b->low && a->high == b->high;
+}
+
+void report_cache_drop(ReportCacheEntry *entry) {
+    free(entry->text);
+    report_cache_bytes -= entry->length;
+    entry->text = NULL;
+    entry->length = 0;
+    entry->valid = false;
+}
+
+// Writes a cached copy of the report to stdout if there is one
+bool report_cache_replay(const ReportKey *key) {
+    for (int i = 0; i < REPORT_CACHE_ENTRIES; i++) {
+        ReportCacheEntry *entry = &report_cache[i];
+        if (entry->valid && report_keys_equal(&entry->key, key)) {
+            entry->last_used = ++report_cache_clock;
+            report_send(entry->text, entry->length);
+            report_cache_hits++;
+            return true;
+        }
+    }
+    report_cache_misses++;
+    return false;
+}
+
+// Prints a freshly built report and keeps it for later polls, evicting the
+// least recently used entries to stay under REPORT_CACHE_MAX_BYTES
+void report_emit(const ReportKey *key, ReportBuffer *out) {
+    if (out->length > 0) {
+        report_send(out->data, out->length);
+    }
+    if (out->length > REPORT_CACHE_MAX_BYTES) {
+        free(out->data);
+        return;
+    }
+
+    for (;;) {
+        ReportCacheEntry *free_slot = NULL;
+        ReportCacheEntry *oldest = NULL;
+        for (int i = 0; i < REPORT_CACHE_ENTRIES; i++) {
+            ReportCacheEntry *entry = &report_cache[i];
+            if (!entry->valid) {
+                if (!free_slot) free_slot = entry;
+            } else if (!oldest || entry->last_used < oldest->last_used) {
+                oldest = entry;
+            }
+        }
+
+        if (free_slot && report_cache_bytes + out->length <= REPORT_CACHE_MAX_BYTES) {
+            free_slot->valid = true;
+            free_slot->key = *key;
+            free_slot->text = out->data;
+            free_slot->length = out->length;
+            free_slot->last_used = ++report_cache_clock;
+            report_cache_bytes += out->length;
+            return;
+        }
+        report_cache_drop(oldest);
+        report_cache_evictions++;
+    }
+}
+
+void report_cache_invalidate_kind(ReportKind kind) {
+    for (int i = 0; i < REPORT_CACHE_ENTRIES; i++) {
+        if (report_cache[i].valid && report_cache[i].key.kind == kind) {
+            report_cache_drop(&report_cache[i]);
+            report_cache_invalidations++;
+        }
+    }
+}
+
+// Drops exactly the cached reports whose output a new trade changes;
+// range reports that the trade falls outside of stay valid
+void report_cache_note_trade(const Transaction *t) {
+    int64_t timestamp = datetime_to_minutes(t->datetime);
+    for (int i = 0; i < REPORT_CACHE_ENTRIES; i++) {
+        ReportCacheEntry *entry = &report_cache[i];
+        if (!entry->valid) continue;
+
+        bool affected = true;
+        if (entry->key.kind == REPORT_ENERGY_RANGE) {
+            affected = t->energy_kwh >= entry->key.low && t->energy_kwh <= entry->key.high;
+        } else if (entry->key.kind == REPORT_TIME_RANGE) {
+            affected = timestamp >= entry->key.low && timestamp <= entry->key.high;
+        }
+        if (affected) {
+            report_cache_drop(entry);
+            report_cache_invalidations++;
+        }
+    }
+}
+
+void print_report_cache_stats() {
+    int entries = 0;
+    for (int i = 0; i < REPORT_CACHE_ENTRIES; i++) {
+        if (report_cache[i].valid) entries++;
+    }
+    long lookups = report_cache_hits + report_cache_misses;
+    printf("\nReport Cache:\n");
+    printf("Hits: %ld, Misses: %ld, Hit rate: %.1f%%\n", report_cache_hits, report_cache_misses,
+           lookups ? 100.0 * report_cache_hits / lookups : 0.0);
+    printf("Entries: %d/%d, Bytes: %zu/%d\n", entries, REPORT_CACHE_ENTRIES,
+           report_cache_bytes, REPORT_CACHE_MAX_BYTES);
+    printf("Invalidations: %ld, Evictions: %ld\n", report_cache_invalidations, report_cache_evictions);
+}
+
+// ---------------------------- Parallel Reports ----------------------------
+
+// A fixed pool of worker threads runs one parallel_for() at a time. Each
+// worker starts with a contiguous slice of the task range and, once its
+// own slice is empty, steals single tasks from the far end of the others.
+
+// Takes the next task from the worker's own slice, else steals one
+int task_pool_next(int worker) {
+    WorkerDeque *own = &task_pool.deques[worker];
+    pthread_mutex_lock(&own->lock);
+    if (own->begin < own->end) {
+        int task = own->begin++;
+        pthread_mutex_unlock(&own->lock);
+        return task;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (int i = 1; i < task_pool.worker_count; i++) {
+        WorkerDeque *victim = &task_pool.deques[(worker + i) % task_pool.worker_count];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->begin < victim->end) {
+            int task = --victim->end;
+            pthread_mutex_unlock(&victim->lock);
+            return task;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return -1;
+}
+
+void task_pool_run(int worker) {
+    int task;
+    while ((task = task_pool_next(worker)) >= 0) {
+        task_pool.fn(task, worker, task_pool.ctx);
+    }
+}
+
+void *task_pool_worker_main(void *arg) {
+    int worker = (int)(intptr_t)arg;
+    uint64_t seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&task_pool.lock);
+        while (task_pool.generation == seen) {
+            pthread_cond_wait(&task_pool.start, &task_pool.lock);
+        }
+        seen = task_pool.generation;
+        pthread_mutex_unlock(&task_pool.lock);
+
+        task_pool_run(worker);
+
+        pthread_mutex_lock(&task_pool.lock);
+        if (--task_pool.active == 0) {
+            pthread_cond_signal(&task_pool.done);
+        }
+        pthread_mutex_unlock(&task_pool.lock);
+    }
+    return NULL;
+}
+
+void task_pool_start() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    task_pool.worker_count = cores < 1 ? 1 : (cores > MAX_REPORT_WORKERS ? MAX_REPORT_WORKERS : (int)cores);
+
+    pthread_mutex_init(&task_pool.lock, NULL);
+    pthread_cond_init(&task_pool.start, NULL);
+    pthread_cond_init(&task_pool.done, NULL);
+    for (int w = 0; w < task_pool.worker_count; w++) {
+        pthread_mutex_init(&task_pool.deques[w].lock, NULL);
+    }
+    // Worker 0 is whichever thread calls parallel_for()
+    for (int w = 1; w < task_pool.worker_count; w++) {
+        pthread_t thread;
+        pthread_create(&thread, NULL, task_pool_worker_main, (void *)(intptr_t)w);
+        pthread_detach(thread);
+    }
+    task_pool.started = true;
+}
+
+// Runs fn(task, worker, ctx) for every task in [0, task_count) and returns
+// when all of them have finished
+void parallel_for(int task_count, TaskFn fn, void *ctx) {
+    if (!task_pool.started) task_pool_start();
+
+    int workers = task_pool.worker_count;
+    if (task_count < PARALLEL_MIN_TASKS || workers == 1) {
+        for (int task = 0; task < task_count; task++) fn(task, 0, ctx);
+        return;
+    }
+
+    for (int w = 0; w < workers; w++) {
+        task_pool.deques[w].begin = (int)((int64_t)task_count * w / workers);
+        task_pool.deques[w].end = (int)((int64_t)task_count * (w + 1) / workers);
+    }
+
+    pthread_mutex_lock(&task_pool.lock);
+    task_pool.fn = fn;
+    task_pool.ctx = ctx;
+    task_pool.active = workers - 1;
+    task_pool.generation++;
+    pthread_cond_broadcast(&task_pool.start);
+    pthread_mutex_unlock(&task_pool.lock);
+
+    task_pool_run(0);
+
+    pthread_mutex_lock(&task_pool.lock);
+    while (task_pool.active > 0) {
+        pthread_cond_wait(&task_pool.done, &task_pool.lock);
+    }
+    pthread_mutex_unlock(&task_pool.lock);
+}
+
+typedef struct ParallelRender {
+    RenderFn render;
+    void *ctx;
+    ReportBuffer *worker_out;   // One buffer per worker
+    ReportSpan *spans;          // Where each task's text ended up
+} ParallelRender;
+
+void parallel_render_task(int task, int worker, void *arg) {
+    ParallelRender *job = (ParallelRender *)arg;
+    ReportBuffer *buf = &job->worker_out[worker];
+    size_t start = buf->length;
+    job->render(task, buf, job->ctx);
+    job->spans[task].worker = worker;
+    job->spans[task].offset = start;
+    job->spans[task].length = buf->length - start;
+}
+
+// Renders task_count report sections in parallel and appends them to `out`
+// in task order, so the text matches a sequential loop byte for byte
+void render_parallel(int task_count, RenderFn render, void *ctx, ReportBuffer *out) {
+    if (task_count <= 0) return;
+    if (!task_pool.started) task_pool_start();
+
+    ParallelRender job;
+    job.render = render;
+    job.ctx = ctx;
+    job.worker_out = (ReportBuffer *)checked_malloc(task_pool.worker_count * sizeof(ReportBuffer));
+    job.spans = (ReportSpan *)checked_malloc(task_count * sizeof(ReportSpan));
+    memset(job.worker_out, 0, task_pool.worker_count * sizeof(ReportBuffer));
+
+    parallel_for(task_count, parallel_render_task, &job);
+
+    for (int task = 0; task < task_count; task++) {
+        const ReportSpan *span = &job.spans[task];
+        report_append(out, job.worker_out[span->worker].data + span->offset, span->length);
+    }
+    for (int w = 0; w < task_pool.worker_count; w++) {
+        free(job.worker_out[w].data);
+    }
+    free(job.worker_out);
+    free(job.spans);
+}
+
+// ---------------------------- Streaming Sketches ----------------------------
+
+// Fixed-size summaries updated with every accepted trade, so the top-trader
+// dashboard never has to sort the full participant tables.
+//  - Space-Saving keeps SKETCH_TOP_K weighted counters. An estimate is never
+//    below the true value and exceeds it by at most its `error`, which is at
+//    most total / SKETCH_TOP_K; anything heavier than that is always listed.
+//  - Count-Min answers any pair's trade count. The estimate is never below
+//    the true count and, with probability 1 - e^-COUNT_MIN_DEPTH, at most
+//    e / COUNT_MIN_WIDTH * total above it.
+
+void space_saving_add(SpaceSaving *ss, uint64_t key, int64_t weight) {
+    ss->total += weight;
+    int min = 0;
+    for (int i = 0; i < ss->size; i++) {
+        if (ss->entries[i].key == key) {
+            ss->entries[i].count += weight;
+            return;
+        }
+        if (ss->entries[i].count < ss->entries[min].count) min = i;
+    }
+    if (ss->size < SKETCH_TOP_K) {
+        SpaceSavingEntry *e = &ss->entries[ss->size++];
+        e->key = key;
+        e->count = weight;
+        e->error = 0;
+        return;
+    }
+
+    // Evict the smallest counter; the newcomer inherits it as possible error
+    SpaceSavingEntry *e = &ss->entries[min];
+    e->key = key;
+    e->error = e->count;
+    e->count += weight;
+}
+
+int compare_space_saving_entries(const void *a, const void *b) {
+    const SpaceSavingEntry *x = (const SpaceSavingEntry *)a;
+    const SpaceSavingEntry *y = (const SpaceSavingEntry *)b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+// Copies the counters into `out` heaviest first; returns how many
+int space_saving_top(const SpaceSaving *ss, SpaceSavingEntry out[SKETCH_TOP_K]) {
+    memcpy(out, ss->entries, ss->size * sizeof(SpaceSavingEntry));
+    qsort(out, ss->size, sizeof(SpaceSavingEntry), compare_space_saving_entries);
+    return ss->size;
+}
+
+int count_min_slot(uint64_t key, int row) {
+    return (int)(idmap_hash(key + (uint64_t)(row + 1) * 0x9e3779b97f4a7c15ULL) % COUNT_MIN_WIDTH);
+}
+
+void count_min_add(CountMin *cm, uint64_t key, int64_t weight) {
+    cm->total += weight;
+    for (int row = 0; row < COUNT_MIN_DEPTH; row++) {
+        cm->counts[row][count_min_slot(key, row)] += weight;
+    }
+}
+
+int64_t count_min_estimate(const CountMin *cm, uint64_t key) {
+    int64_t estimate = INT64_MAX;
+    for (int row = 0; row < COUNT_MIN_DEPTH; row++) {
+        int64_t c = cm->counts[row][count_min_slot(key, row)];
+        if (c < estimate) estimate = c;
+    }
+    return estimate;
+}
+
+// Keyed by ids rather than dense indices so the sketches stand on their own
+uint64_t sketch_pair_key(int buyer_id, int seller_id) {
+    return ((uint64_t)(uint32_t)buyer_id << 32) | (uint32_t)seller_id;
+}
+
+void sketch_note_trade(const Transaction *t) {
+    space_saving_add(&trade_sketches.buyer_energy, (uint32_t)t->buyer_id, t->energy_kwh);
+    uint64_t pair = sketch_pair_key(t->buyer_id, t->seller_id);
+    space_saving_add(&trade_sketches.pair_trades, pair, 1);
+    count_min_add(&trade_sketches.pair_counts, pair, 1);
+}
+
+// "Top 20 buyers by energy" and "top 20 pairs by trade count" from the
+// Space-Saving summaries; cost depends only on SKETCH_TOP_K
+void sketch_top_traders() {
+    SpaceSavingEntry top[SKETCH_TOP_K];
+    ReportBuffer out = {0};
+    char energy[32], error[32], bound[32];
+
+    const SpaceSaving *buyers_ss = &trade_sketches.buyer_energy;
+    int n = space_saving_top(buyers_ss, top);
+    if (n > SKETCH_REPORT_TOP) n = SKETCH_REPORT_TOP;
+    report_printf(&out, "\nTop %d Buyers by Energy (streaming estimate):\n", SKETCH_REPORT_TOP);
+    report_printf(&out, "%-8s %-15s %-15s\n", "Buyer", "Energy(kWh)", "Max Over(kWh)");
+    report_printf(&out, "----------------------------------------\n");
+    for (int i = 0; i < n; i++) {
+        report_printf(&out, "%-8d %-15s %-15s\n", (int)(uint32_t)top[i].key,
+                      format_energy(energy, top[i].count), format_energy(error, top[i].error));
+    }
+    report_printf(&out, "Every buyer above %s kWh is listed.\n",
+                  format_energy(bound, buyers_ss->total / SKETCH_TOP_K));
+
+    const SpaceSaving *pairs_ss = &trade_sketches.pair_trades;
+    n = space_saving_top(pairs_ss, top);
+    if (n > SKETCH_REPORT_TOP) n = SKETCH_REPORT_TOP;
+    report_printf(&out, "\nTop %d Buyer/Seller Pairs by Transactions (streaming estimate):\n", SKETCH_REPORT_TOP);
+    report_printf(&out, "%-8s %-8s %-15s %-15s\n", "Buyer", "Seller", "Transactions", "Max Over");
+    report_printf(&out, "------------------------------------------------\n");
+    for (int i = 0; i < n; i++) {
+        report_printf(&out, "%-8d %-8d %-15lld %-15lld\n",
+                      (int)(uint32_t)(top[i].key >> 32), (int)(uint32_t)top[i].key,
+                      (long long)top[i].count, (long long)top[i].error);
+    }
+    report_printf(&out, "Every pair with more than %lld transactions is listed.\n",
+                  (long long)(pairs_ss->total / SKETCH_TOP_K));
+    report_write(&out);
+}
+
+void sketch_pair_count(int buyer_id, int seller_id) {
+    const CountMin *cm = &trade_sketches.pair_counts;
+    int64_t estimate = count_min_estimate(cm, sketch_pair_key(buyer_id, seller_id));
+    // e / width, rounded up
+    int64_t slack = (cm->total * 2718281 + (int64_t)COUNT_MIN_WIDTH * 1000000 - 1) /
+                    ((int64_t)COUNT_MIN_WIDTH * 1000000);
+    printf("\nBuyer %d / Seller %d: about %lld transactions\n", buyer_id, seller_id, (long long)estimate);
+    printf("Never below the true count; at most %lld above it with 98%% confidence.\n",
+           (long long)slack);
+}
+
+// ---------------------------- Background Jobs ----------------------------
+
+// Checkpoints and replica images serialize the whole engine, which must not
+// happen on the operator thread. A job forks instead: the child owns a
+// copy-on-write snapshot as of the fork and writes it out, while the parent
+// carries on taking trades and later collects the child's result through a
+// pipe. Only the forking thread exists in the child, so it must stay away
+// from the persistence threads and leave through background_exit().
+
+// Returns 0 in the child, 1 in the parent once the job runs, -1 on failure
+int background_start(BackgroundJob *job) {
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+
+    // Unflushed output would otherwise be written twice
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        job->result_fd = fds[1];
+        return 0;
+    }
+    close(fds[1]);
+    job->pid = pid;
+    job->result_fd = fds[0];
+    return 1;
+}
+
+// Child side: sends `result` (NULL on failure) to the parent and exits
+// without running the parent's exit handlers or flushing its buffers
+void background_exit(BackgroundJob *job, const void *result, size_t bytes) {
+    bool ok = result != NULL && write_all(job->result_fd, (const char *)result, bytes);
+    _exit(ok ? 0 : 1);
+}
+
+// Parent side: checks on the job, waiting for it if `wait` is set. Once it
+// is done its result is in `result`.
+JobState background_poll(BackgroundJob *job, bool wait, void *result, size_t bytes) {
+    if (job->pid == 0) return JOB_IDLE;
+
+    int status;
+    pid_t done;
+    do {
+        done = waitpid(job->pid, &status, wait ? 0 : WNOHANG);
+    } while (done < 0 && errno == EINTR);
+    if (done == 0) return JOB_RUNNING;
+
+    bool ok = done == job->pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+              read(job->result_fd, result, bytes) == (ssize_t)bytes;
+    close(job->result_fd);
+    job->pid = 0;
+    return ok ? JOB_DONE : JOB_FAILED;
+}
+
+// ---------------------------- Checkpoints ----------------------------
+
+// A checkpoint is the whole engine state (participants with their rates,
+// regular-buyer flags and aggregates, hot trades, sealed segments and the
+// id set) as of a known prefix of TRANSACTIONS_FILE. Restart loads it and
+// replays only the journal rows appended after that prefix.
+
+uint64_t fnv1a(const void *data, size_t length) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool checkpoint_put(FILE *file, const void *data, size_t bytes) {
+    return bytes == 0 || fwrite(data, 1, bytes, file) == bytes;
+}
+
+bool checkpoint_get(FILE *file, void *data, size_t bytes) {
+    return bytes == 0 || fread(data, 1, bytes, file) == bytes;
+}
+
+// Reads `bytes` into a fresh allocation; NULL (with *ok cleared) on a short read
+void *checkpoint_get_array(FILE *file, size_t bytes, bool *ok) {
+    if (bytes == 0) return NULL;
+    void *data = checked_malloc(bytes);
+    if (!checkpoint_get(file, data, bytes)) {
+        *ok = false;
+    }
+    return data;
+}
+
+bool checkpoint_put_segment(FILE *file, const ColdSegment *seg) {
+    int rows = seg->row_count;
+    return checkpoint_put(file, seg, sizeof(ColdSegment)) &&
+           checkpoint_put(file, seg->id_deltas, seg->id_bytes) &&
+           checkpoint_put(file, seg->timestamp_deltas, seg->timestamp_bytes) &&
+           checkpoint_put(file, seg->buyer_dict, seg->buyer_dict_size * sizeof(int)) &&
+           checkpoint_put(file, seg->seller_dict, seg->seller_dict_size * sizeof(int)) &&
+           checkpoint_put(file, seg->rate_dict, (size_t)seg->rate_dict_size * 2 * sizeof(money_t)) &&
+           checkpoint_put(file, seg->buyer_codes.words, packed_bytes(&seg->buyer_codes, rows)) &&
+           checkpoint_put(file, seg->seller_codes.words, packed_bytes(&seg->seller_codes, rows)) &&
+           checkpoint_put(file, seg->rate_codes.words, packed_bytes(&seg->rate_codes, rows)) &&
+           checkpoint_put(file, seg->energy.words, packed_bytes(&seg->energy, rows)) &&
+           checkpoint_put(file, seg->price_per_kwh.words, packed_bytes(&seg->price_per_kwh, rows)) &&
+           checkpoint_put(file, seg->total_price.words, packed_bytes(&seg->total_price, rows));
+}
+
+bool checkpoint_get_segment(FILE *file, ColdSegment *seg) {
+    if (!checkpoint_get(file, seg, sizeof(ColdSegment))) return false;
+    int rows = seg->row_count;
+    bool ok = true;
+    seg->id_deltas = (uint8_t *)checkpoint_get_array(file, seg->id_bytes, &ok);
+    seg->timestamp_deltas = (uint8_t *)checkpoint_get_array(file, seg->timestamp_bytes, &ok);
+    seg->buyer_dict = (int *)checkpoint_get_array(file, seg->buyer_dict_size * sizeof(int), &ok);
+    seg->seller_dict = (int *)checkpoint_get_array(file, seg->seller_dict_size * sizeof(int), &ok);
+    seg->rate_dict = (money_t *)checkpoint_get_array(file, seg->rate_dict_size * 2 * sizeof(money_t), &ok);
+    PackedColumn *columns[] = { &seg->buyer_codes, &seg->seller_codes, &seg->rate_codes,
+                                &seg->energy, &seg->price_per_kwh, &seg->total_price };
+    for (int i = 0; i < 6; i++) {
+        columns[i]->words = (uint64_t *)checkpoint_get_array(file, packed_bytes(columns[i], rows), &ok);
+    }
+    return ok;
+}
+
+// Atomically replaces CHECKPOINT_FILE with the current state, which must
+// cover exactly the first `journal_offset` bytes (`journal_lines` lines) of
+// TRANSACTIONS_FILE. `tail` holds the journal bytes just before that offset.
+bool write_checkpoint(int64_t journal_offset, int64_t journal_lines, bool in_sellers,
+                      const uint8_t *tail, uint32_t tail_length) {
+    char *payload = NULL;
+    size_t payload_bytes = 0;
+    FILE *file = open_memstream(&payload, &payload_bytes);
+    if (!file) return false;
+
+    // Every write is checked: a short payload must never be renamed into place
+    bool ok = checkpoint_put(file, &latest_timestamp, sizeof(latest_timestamp)) &&
+              checkpoint_put(file, &oldest_hot_timestamp, sizeof(oldest_hot_timestamp)) &&
+              checkpoint_put(file, &cold_row_count, sizeof(int)) &&
+              checkpoint_put(file, &hot_inserts_since_seal, sizeof(int));
+
+    ok = ok && checkpoint_put(file, &seller_count, sizeof(int)) &&
+         checkpoint_put(file, sellers, seller_count * sizeof(SellerKey)) &&
+         checkpoint_put(file, &buyer_count, sizeof(int)) &&
+         checkpoint_put(file, buyers, buyer_count * sizeof(BuyerKey)) &&
+         checkpoint_put(file, &pair_count, sizeof(int)) &&
+         checkpoint_put(file, pairs, pair_count * sizeof(PairStats));
+
+    ok = ok && checkpoint_put(file, &transaction_index, sizeof(int));
+    for (int i = 0; ok && i < transaction_index; i++) {
+        ok = checkpoint_put(file, all_transactions[i], sizeof(Transaction));
+    }
+
+    ok = ok && checkpoint_put(file, &cold_segment_count, sizeof(int));
+    for (int i = 0; ok && i < cold_segment_count; i++) {
+        ok = checkpoint_put_segment(file, &cold_segments[i]);
+    }
+    ok = ok && idset_write(&transaction_ids, file) &&
+         checkpoint_put(file, &trade_sketches, sizeof(TradeSketches));
+
+    if (fclose(file) != 0 || !ok) {
+        free(payload);
+        return false;
+    }
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+    header.version = CHECKPOINT_VERSION;
+    header.record_sizes[0] = sizeof(Transaction);
+    header.record_sizes[1] = sizeof(SellerKey);
+    header.record_sizes[2] = sizeof(BuyerKey);
+    header.record_sizes[3] = sizeof(PairStats);
+    header.record_sizes[4] = sizeof(ColdSegment);
+    header.journal_offset = journal_offset;
+    header.journal_lines = journal_lines;
+    header.journal_in_sellers = in_sellers;
+    header.tail_length = tail_length;
+    memcpy(header.journal_tail, tail, tail_length);
+    header.payload_bytes = payload_bytes;
+    header.payload_checksum = fnv1a(payload, payload_bytes);
+
+    // Write-temp-then-rename: a crash leaves either the old or the new file
+    int fd = open(CHECKPOINT_TEMP_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ok = fd >= 0 &&
+              write_all(fd, (const char *)&header, sizeof(header)) &&
+              write_all(fd, payload, payload_bytes) &&
+              fsync(fd) == 0;
+    if (fd >= 0 && close(fd) != 0) ok = false;
+    free(payload);
+    if (!ok || rename(CHECKPOINT_TEMP_FILE, CHECKPOINT_FILE) != 0) {
+        unlink(CHECKPOINT_TEMP_FILE);
+        return false;
+    }
+
+    // Make the rename itself durable
+    int dir = open(".", O_RDONLY);
+    if (dir >= 0) {
+        fsync(dir);
+        close(dir);
+    }
+    return true;
+}
+
+// Finds where the journal row of trade `last_id` ends, scanning from the
+// last known point and waiting for the persistence writer to append it.
+// Trade ids are unique, so the row is the first line starting "<id>,".
+// With last_id < 0 the journal as loaded is covered.
+bool checkpoint_find_journal_end(int fd, int last_id, int64_t *offset, int64_t *lines) {
+    *offset = journal_known_bytes;
+    *lines = journal_known_lines;
+    if (last_id < 0) return true;
+
+    char prefix[16];
+    int prefix_length = snprintf(prefix, sizeof(prefix), "%d,", last_id);
+    char start[16];             // Beginning of the current line
+    int start_length = 0;       // -1 while inside a line that began before the scan
+    char before = '\n';
+    if (journal_known_bytes > 0 && pread(fd, &before, 1, journal_known_bytes - 1) != 1) return false;
+    if (before != '\n') start_length = -1;
+
+    int64_t position = journal_known_bytes;
+    int64_t line_count = journal_known_lines;
+    time_t deadline = time(NULL) + CHECKPOINT_WAIT_SECONDS;
+    char chunk[64 * 1024];
+    for (;;) {
+        ssize_t n = pread(fd, chunk, sizeof(chunk), position);
+        if (n < 0) return false;
+        if (n == 0) {
+            // Not written yet; give up if the writer is stuck or gone
+            if (time(NULL) > deadline || getppid() == 1) return false;
+            struct timespec pause = {0, 2000000};
+            nanosleep(&pause, NULL);
+            continue;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            if (chunk[i] == '\n') {
+                line_count++;
+                if (start_length >= prefix_length && memcmp(start, prefix, prefix_length) == 0) {
+                    *offset = position + i + 1;
+                    *lines = line_count;
+                    return true;
+                }
+                start_length = 0;
+            } else if (start_length >= 0 && start_length < (int)sizeof(start)) {
+                start[start_length++] = chunk[i];
+            }
+        }
+        position += n;
+    }
+}
+
+// Runs in the child of checkpoint_start(); never returns
+void checkpoint_child(int last_id) {
+    CheckpointResult result;
+    int fd = open(TRANSACTIONS_FILE, O_RDONLY);
+    bool ok = fd >= 0 &&
+              checkpoint_find_journal_end(fd, last_id, &result.journal_offset, &result.journal_lines) &&
+              fsync(fd) == 0;
+
+    uint8_t tail[CHECKPOINT_TAIL_BYTES];
+    uint32_t tail_length = result.journal_offset < CHECKPOINT_TAIL_BYTES
+                           ? (uint32_t)result.journal_offset : CHECKPOINT_TAIL_BYTES;
+    ok = ok && pread(fd, tail, tail_length, result.journal_offset - tail_length) == (ssize_t)tail_length;
+    if (fd >= 0) close(fd);
+
+    // Covering appended trades means the journal has left any seller section
+    bool in_sellers = last_id < 0 && file_ends_in_sellers;
+    ok = ok && write_checkpoint(result.journal_offset, result.journal_lines, in_sellers, tail, tail_length);
+    background_exit(&checkpoint_job, ok ? &result : NULL, sizeof(result));
+}
+
+// Checkpoints in the background: the state as of trade `last_id` (the
+// latest one), or as loaded when last_id < 0. One runs at a time.
+void checkpoint_start(int last_id) {
+    if (checkpoint_job.pid != 0) return;
+    int trades = trades_since_checkpoint;
+    int started = background_start(&checkpoint_job);
+    if (started == 0) checkpoint_child(last_id);
+    if (started > 0) {
+        checkpoint_job_trades = trades;
+    } else {
+        printf("Error: Could not start a checkpoint.\n");
+        checkpoint_due = trades_since_checkpoint + CHECKPOINT_INTERVAL;
+    }
+}
+
+// Collects a finished background checkpoint, waiting for it if `wait` is set
+void checkpoint_poll(bool wait) {
+    CheckpointResult result;
+    JobState state = background_poll(&checkpoint_job, wait, &result, sizeof(result));
+    if (state == JOB_DONE) {
+        journal_known_bytes = result.journal_offset;
+        journal_known_lines = result.journal_lines;
+        trades_since_checkpoint -= checkpoint_job_trades;
+        checkpoint_due = CHECKPOINT_INTERVAL;
+    } else if (state == JOB_FAILED) {
+        printf("Error: Could not save checkpoint %s\n", CHECKPOINT_FILE);
+        checkpoint_due = trades_since_checkpoint + CHECKPOINT_INTERVAL;
+    }
+}
+
+// Restores the state saved by write_checkpoint() if CHECKPOINT_FILE exists
+// and still matches `journal`. On success the journal should be replayed
+// from *journal_offset, which is line *journal_lines + 1, in the section
+// *in_sellers says it is in.
+bool load_checkpoint(FILE *journal, int64_t *journal_offset, int *journal_lines, bool *in_sellers) {
+    FILE *file = fopen(CHECKPOINT_FILE, "rb");
+    if (!file) return false;
+
+    CheckpointHeader header;
+    bool ok = checkpoint_get(file, &header, sizeof(header)) &&
+              memcmp(header.magic, CHECKPOINT_MAGIC, 4) == 0 &&
+              header.version == CHECKPOINT_VERSION &&
+              header.record_sizes[0] == sizeof(Transaction) &&
+              header.record_sizes[1] == sizeof(SellerKey) &&
+              header.record_sizes[2] == sizeof(BuyerKey) &&
+              header.record_sizes[3] == sizeof(PairStats) &&
+              header.record_sizes[4] == sizeof(ColdSegment) &&
+              header.tail_length <= CHECKPOINT_TAIL_BYTES;
+    char *payload = NULL;
+    if (ok) {
+        payload = (char *)checkpoint_get_array(file, header.payload_bytes, &ok);
+        ok = ok && fnv1a(payload, header.payload_bytes) == header.payload_checksum;
+    }
+    fclose(file);
+
+    // The journal must still start with the prefix the checkpoint covers
+    struct stat st;
+    uint8_t tail[CHECKPOINT_TAIL_BYTES];
+    ok = ok && fstat(fileno(journal), &st) == 0 && st.st_size >= header.journal_offset &&
+         pread(fileno(journal), tail, header.tail_length,
+               header.journal_offset - header.tail_length) == (ssize_t)header.tail_length &&
+         memcmp(tail, header.journal_tail, header.tail_length) == 0;
+    if (!ok) {
+        printf("Warning: %s is unusable or out of date; replaying all of %s.\n",
+               CHECKPOINT_FILE, TRANSACTIONS_FILE);
+        free(payload);
+        return false;
+    }
+
+    file = fmemopen(payload, header.payload_bytes, "rb");
+    if (!file) {
+        free(payload);
+        return false;
+    }
+    ok = checkpoint_get(file, &latest_timestamp, sizeof(latest_timestamp)) &&
+         checkpoint_get(file, &oldest_hot_timestamp, sizeof(oldest_hot_timestamp)) &&
+         checkpoint_get(file, &cold_row_count, sizeof(int)) &&
+         checkpoint_get(file, &hot_inserts_since_seal, sizeof(int));
+
+    // Participants: the interning maps are rebuilt from the records
+    int count = 0;
+    ok = ok && checkpoint_get(file, &count, sizeof(int));
+    sellers = (SellerKey *)checkpoint_get_array(file, count * sizeof(SellerKey), &ok);
+    seller_count = seller_capacity = count;
+    seller_order = (int *)checked_malloc((count + 1) * sizeof(int));
+    seller_order_dirty = true;
+    for (int i = 0; ok && i < seller_count; i++) {
+        sellers[i].transaction_tree = NULL;
+        idmap_put(&seller_ids, (uint64_t)(uint32_t)sellers[i].seller_id, i);
+    }
+
+    count = 0;
+    ok = ok && checkpoint_get(file, &count, sizeof(int));
+    buyers = (BuyerKey *)checkpoint_get_array(file, count * sizeof(BuyerKey), &ok);
+    buyer_count = buyer_capacity = count;
+    buyer_order = (int *)checked_malloc((count + 1) * sizeof(int));
+    buyer_order_dirty = true;
+    for (int i = 0; ok && i < buyer_count; i++) {
+        buyers[i].transaction_tree = NULL;
+        idmap_put(&buyer_ids, (uint64_t)(uint32_t)buyers[i].buyer_id, i);
+    }
+
+    count = 0;
+    ok = ok && checkpoint_get(file, &count, sizeof(int));
+    pairs = (PairStats *)checkpoint_get_array(file, count * sizeof(PairStats), &ok);
+    pair_count = pair_capacity = count;
+    for (int i = 0; ok && i < pair_count; i++) {
+        idmap_put(&pair_ids, pair_key(pairs[i].buyer_index, pairs[i].seller_index), i);
+    }
+
+    // Hot trades go back into the trees; sealed ones stay encoded
+    count = 0;
+    ok = ok && checkpoint_get(file, &count, sizeof(int));
+    for (int i = 0; ok && i < count; i++) {
+        Transaction *t = (Transaction *)checked_malloc(sizeof(Transaction));
+        ok = checkpoint_get(file, t, sizeof(Transaction));
+        if (!ok) {
+            free(t);
+            break;
+        }
+        SellerKey *s = &sellers[find_seller_index(t->seller_id)];
+        BuyerKey *b = &buyers[find_buyer_index(t->buyer_id)];
+        all_transactions = (Transaction **)grow_array(all_transactions, &transaction_capacity,
+                                                      transaction_index + 1, sizeof(Transaction *));
+        all_transactions[transaction_index++] = t;
+        global_transaction_tree = insert_transaction(global_transaction_tree, t);
+        s->transaction_tree = insert_transaction(s->transaction_tree, t);
+        b->transaction_tree = insert_transaction(b->transaction_tree, t);
+        index_trade_times(t, datetime_to_minutes(t->datetime), (int)(s - sellers), (int)(b - buyers));
+    }
+
+    count = 0;
+    ok = ok && checkpoint_get(file, &count, sizeof(int));
+    for (int i = 0; ok && i < count; i++) {
+        cold_segments = (ColdSegment *)grow_array(cold_segments, &cold_segment_capacity,
+                                                  cold_segment_count + 1, sizeof(ColdSegment));
+        ok = checkpoint_get_segment(file, &cold_segments[cold_segment_count++]);
+    }
+    ok = ok && idset_read(&transaction_ids, file);
+    ok = ok && checkpoint_get(file, &trade_sketches, sizeof(TradeSketches));
+    fclose(file);
+    free(payload);
+
+    if (!ok) {
+        // The checksum matched, so this is a bug rather than a torn write
+        printf("Error: %s is inconsistent; remove it to replay %s.\n", CHECKPOINT_FILE, TRANSACTIONS_FILE);
+        exit(1);
+    }
+    *journal_offset = header.journal_offset;
+    *journal_lines = (int)header.journal_lines;
+    *in_sellers = header.journal_in_sellers != 0;
+    return true;
+}
+
+// ---------------------------- Read Replicas ----------------------------
+
+// The writer publishes immutable, versioned images of the engine state in
+// POSIX shared memory. Inside an image everything is addressed by offsets
+// from its base, so any process can map it anywhere. Replica processes
+// (started with --replica) point the participant tables, trade records and
+// cold segment payloads straight into their mapping and only build the hot
+// B+ trees, whose nodes hold process-local pointers, themselves. Writers
+// never wait on readers: a new version goes to a new object and the old
+// one is unlinked, which leaves existing mappings intact. Publishing is
+// opt-in (--publish), since building an image costs the writer a full copy.
+
+size_t replica_align(size_t offset) {
+    return (offset + 63) & ~(size_t)63;
+}
+
+// Names the objects after the data file, so instances working on different
+// files never see each other's versions
+void replica_name_init() {
+    char path[PATH_MAX + sizeof(TRANSACTIONS_FILE) + 1];
+    if (!realpath(".", path)) strcpy(path, ".");
+    strcat(path, "/" TRANSACTIONS_FILE);
+    snprintf(replica_control_name, sizeof(replica_control_name), "%s.%016llx",
+             REPLICA_SHM_NAME, (unsigned long long)fnv1a(path, strlen(path)));
+}
+
+void replica_shm_name(char name[64], uint64_t generation) {
+    snprintf(name, 64, "%s.%llu", replica_control_name, (unsigned long long)generation);
+}
+
+// Lays out (when base is NULL) or fills an image; returns its size
+size_t replica_build_image(char *base, uint64_t generation) {
+    ReplicaHeader header;
+    memset(&header, 0, sizeof(header));
+    size_t offset = replica_align(sizeof(ReplicaHeader));
+
+    header.sellers_offset = offset;
+    offset = replica_align(offset + seller_count * sizeof(SellerKey));
+    header.buyers_offset = offset;
+    offset = replica_align(offset + buyer_count * sizeof(BuyerKey));
+    header.pairs_offset = offset;
+    offset = replica_align(offset + pair_count * sizeof(PairStats));
+    header.hot_offset = offset;
+    offset = replica_align(offset + transaction_index * sizeof(Transaction));
+    header.segments_offset = offset;
+    offset = replica_align(offset + cold_segment_count * sizeof(ColdSegment));
+    header.segment_payloads_offset = offset;
+    offset = replica_align(offset + cold_segment_count * sizeof(ReplicaSegment));
+    header.sketches_offset = offset;
+    offset = replica_align(offset + sizeof(TradeSketches));
+
+    // Segment payloads follow, each array at its own aligned offset
+    for (int i = 0; i < cold_segment_count; i++) {
+        const ColdSegment *seg = &cold_segments[i];
+        ReplicaSegment rs;
+        const void *arrays[REPLICA_SEGMENT_ARRAYS] = {
+            seg->id_deltas, seg->timestamp_deltas, seg->buyer_dict, seg->seller_dict, seg->rate_dict,
+            seg->buyer_codes.words, seg->seller_codes.words, seg->rate_codes.words,
+            seg->energy.words, seg->price_per_kwh.words, seg->total_price.words
+        };
+        size_t sizes[REPLICA_SEGMENT_ARRAYS] = {
+            seg->id_bytes, seg->timestamp_bytes,
+            seg->buyer_dict_size * sizeof(int), seg->seller_dict_size * sizeof(int),
+            seg->rate_dict_size * 2 * sizeof(money_t),
+            packed_bytes(&seg->buyer_codes, seg->row_count),
+            packed_bytes(&seg->seller_codes, seg->row_count),
+            packed_bytes(&seg->rate_codes, seg->row_count),
+            packed_bytes(&seg->energy, seg->row_count),
+            packed_bytes(&seg->price_per_kwh, seg->row_count),
+            packed_bytes(&seg->total_price, seg->row_count)
+        };
+        for (int a = 0; a < REPLICA_SEGMENT_ARRAYS; a++) {
+            rs.offsets[a] = offset;
+            if (base && sizes[a] > 0) memcpy(base + offset, arrays[a], sizes[a]);
+            offset = replica_align(offset + sizes[a]);
+        }
+        if (base) {
+            ColdSegment *copy = (ColdSegment *)(base + header.segments_offset) + i;
+            *copy = *seg;
+            copy->id_deltas = copy->timestamp_deltas = NULL;
+            copy->buyer_dict = copy->seller_dict = NULL;
+            copy->rate_dict = NULL;
+            copy->buyer_codes.words = copy->seller_codes.words = copy->rate_codes.words = NULL;
+            copy->energy.words = copy->price_per_kwh.words = copy->total_price.words = NULL;
+            ((ReplicaSegment *)(base + header.segment_payloads_offset))[i] = rs;
+        }
+    }
+    if (!base) return offset;
+
+    memcpy(header.magic, REPLICA_MAGIC, 4);
+    header.version = REPLICA_VERSION;
+    header.record_sizes[0] = sizeof(Transaction);
+    header.record_sizes[1] = sizeof(SellerKey);
+    header.record_sizes[2] = sizeof(BuyerKey);
+    header.record_sizes[3] = sizeof(PairStats);
+    header.record_sizes[4] = sizeof(ColdSegment);
+    header.generation = generation;
+    header.total_bytes = offset;
+    header.seller_count = seller_count;
+    header.buyer_count = buyer_count;
+    header.pair_count = pair_count;
+    header.hot_count = transaction_index;
+    header.segment_count = cold_segment_count;
+    header.cold_row_count = cold_row_count;
+    header.latest_timestamp = latest_timestamp;
+    header.oldest_hot_timestamp = oldest_hot_timestamp;
+
+    memcpy(base + header.sellers_offset, sellers, seller_count * sizeof(SellerKey));
+    memcpy(base + header.buyers_offset, buyers, buyer_count * sizeof(BuyerKey));
+    memcpy(base + header.pairs_offset, pairs, pair_count * sizeof(PairStats));
+    memcpy(base + header.sketches_offset, &trade_sketches, sizeof(TradeSketches));
+    Transaction *hot = (Transaction *)(base + header.hot_offset);
+    for (int i = 0; i < transaction_index; i++) {
+        hot[i] = *all_transactions[i];
+    }
+    memcpy(base, &header, sizeof(header));
+    return offset;
+}
+
+// Writer side: creates or reopens the control object readers watch
+bool replica_open_control() {
+    if (replica_control) return true;
+    int fd = shm_open(replica_control_name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(ReplicaControl)) != 0) {
+        if (fd >= 0) close(fd);
+        printf("Warning: Could not create shared memory for read replicas.\n");
+        return false;
+    }
+    void *map = mmap(NULL, sizeof(ReplicaControl), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    replica_control = (ReplicaControl *)map;
+    // Carry on from a previous writer's numbering so names stay unique
+    replica_generation = atomic_load(&replica_control->generation);
+    atomic_store(&replica_control->writer_pid, (int)getpid());
+    return true;
+}
+
+// Runs in the child of replica_publish_start(); never returns. The control
+// mapping is shared, so the child can switch readers over itself.
+void replica_publish_child(uint64_t generation) {
+    char name[64];
+    replica_shm_name(name, generation);
+    size_t size = replica_build_image(NULL, generation);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) background_exit(&replica_job, NULL, 0);
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        background_exit(&replica_job, NULL, 0);
+    }
+    char *base = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name);
+        background_exit(&replica_job, NULL, 0);
+    }
+    replica_build_image(base, generation);
+    munmap(base, size);
+
+    // Readers see the new version only once it is complete
+    atomic_store(&replica_control->generation, generation);
+    if (replica_generation > 0) {
+        replica_shm_name(name, replica_generation);
+        shm_unlink(name);
+    }
+    background_exit(&replica_job, &generation, sizeof(generation));
+}
+
+// Writer side: publishes the current state as the next version in the
+// background. Skipped while the previous version is still being built.
+void replica_publish_start() {
+    if (!replica_publishing || replica_job.pid != 0) return;
+    if (!replica_open_control()) return;
+    int started = background_start(&replica_job);
+    if (started == 0) replica_publish_child(replica_generation + 1);
+    if (started < 0) printf("Warning: Could not start publishing a read replica version.\n");
+    trades_since_publish = 0;
+}
+
+// Collects a finished publish, waiting for it if `wait` is set
+void replica_publish_poll(bool wait) {
+    uint64_t generation;
+    JobState state = background_poll(&replica_job, wait, &generation, sizeof(generation));
+    if (state == JOB_DONE) {
+        replica_generation = generation;
+    } else if (state == JOB_FAILED) {
+        printf("Warning: Could not publish a read replica version.\n");
+    }
+}
+
+// Writer side: removes the published version and the control object on
+// exit. Attached replicas keep their mappings.
+void replica_withdraw() {
+    if (!replica_control) return;
+    atomic_store(&replica_control->writer_pid, 0);
+    char name[64];
+    replica_shm_name(name, replica_generation);
+    shm_unlink(name);
+    shm_unlink(replica_control_name);
+    munmap(replica_control, sizeof(ReplicaControl));
+    replica_control = NULL;
+}
+
+// Replica side: drops the process-local structures built over a mapping
+void replica_release() {
+    free_tree_nodes(global_transaction_tree);
+    global_transaction_tree = NULL;
+    for (int i = 0; i < seller_count; i++) free_tree_nodes(sellers[i].transaction_tree);
+    for (int i = 0; i < buyer_count; i++) free_tree_nodes(buyers[i].transaction_tree);
+    free_time_nodes(seller_time_index);
+    free_time_nodes(buyer_time_index);
+    seller_time_index = buyer_time_index = NULL;
+    free(seller_order);
+    free(buyer_order);
+    free(all_transactions);
+    free(cold_segments);
+    free(seller_ids.keys);
+    free(seller_ids.values);
+    free(buyer_ids.keys);
+    free(buyer_ids.values);
+    free(pair_ids.keys);
+    free(pair_ids.values);
+    memset(&seller_ids, 0, sizeof(IdMap));
+    memset(&buyer_ids, 0, sizeof(IdMap));
+    memset(&pair_ids, 0, sizeof(IdMap));
+    all_transactions = NULL;
+    cold_segments = NULL;
+    transaction_capacity = cold_segment_capacity = 0;
+    for (int i = 0; i < REPORT_CACHE_ENTRIES; i++) {
+        if (report_cache[i].valid) report_cache_drop(&report_cache[i]);
+    }
+    if (replica_base) munmap(replica_base, replica_bytes);
+    replica_base = NULL;
+}
+
+// Replica side: maps the newest published version if it changed. The image
+// is mapped private, so the tree roots stored in the participant records
+// are written to process-local copies of just those pages.
+bool replica_refresh() {
+    if (!replica_control) {
+        int fd = shm_open(replica_control_name, O_RDONLY, 0);
+        if (fd < 0) return false;
+        void *map = mmap(NULL, sizeof(ReplicaControl), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return false;
+        replica_control = (ReplicaControl *)map;
+    }
+
+    for (;;) {
+        // With no writer running, keep whatever version is mapped
+        if (atomic_load(&replica_control->writer_pid) == 0) return replica_base != NULL;
+        uint64_t generation = atomic_load(&replica_control->generation);
+        if (generation == 0) return false;
+        if (generation == replica_generation) return true;
+
+        char name[64];
+        replica_shm_name(name, generation);
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) {
+            // Superseded while we looked: try the newer one
+            if (atomic_load(&replica_control->generation) != generation) continue;
+            return replica_base != NULL;
+        }
+        struct stat st;
+        char *base = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(ReplicaHeader)) {
+            base = (char *)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (base == MAP_FAILED) return false;
+
+        const ReplicaHeader *h = (const ReplicaHeader *)base;
+        if (memcmp(h->magic, REPLICA_MAGIC, 4) != 0 || h->version != REPLICA_VERSION ||
+            h->record_sizes[0] != sizeof(Transaction) || h->record_sizes[1] != sizeof(SellerKey) ||
+            h->record_sizes[2] != sizeof(BuyerKey) || h->record_sizes[3] != sizeof(PairStats) ||
+            h->record_sizes[4] != sizeof(ColdSegment) || h->total_bytes > (uint64_t)st.st_size) {
+            munmap(base, st.st_size);
+            printf("Error: Published snapshot has an incompatible layout.\n");
+            return false;
+        }
+
+        replica_release();
+        replica_base = base;
+        replica_bytes = st.st_size;
+        replica_generation = generation;
+
+        sellers = (SellerKey *)(base + h->sellers_offset);
+        seller_count = seller_capacity = h->seller_count;
+        buyers = (BuyerKey *)(base + h->buyers_offset);
+        buyer_count = buyer_capacity = h->buyer_count;
+        pairs = (PairStats *)(base + h->pairs_offset);
+        pair_count = pair_capacity = h->pair_count;
+        cold_row_count = h->cold_row_count;
+        trade_sketches = *(const TradeSketches *)(base + h->sketches_offset);
+        latest_timestamp = h->latest_timestamp;
+        oldest_hot_timestamp = h->oldest_hot_timestamp;
+
+        seller_order = (int *)checked_malloc((seller_count + 1) * sizeof(int));
+        buyer_order = (int *)checked_malloc((buyer_count + 1) * sizeof(int));
+        seller_order_dirty = buyer_order_dirty = true;
+        for (int i = 0; i < seller_count; i++) {
+            sellers[i].transaction_tree = NULL;
+            idmap_put(&seller_ids, (uint64_t)(uint32_t)sellers[i].seller_id, i);
+        }
+        for (int i = 0; i < buyer_count; i++) {
+            buyers[i].transaction_tree = NULL;
+            idmap_put(&buyer_ids, (uint64_t)(uint32_t)buyers[i].buyer_id, i);
+        }
+        for (int i = 0; i < pair_count; i++) {
+            idmap_put(&pair_ids, pair_key(pairs[i].buyer_index, pairs[i].seller_index), i);
+        }
+
+        // Cold segments: local descriptors over the mapped payloads
+        cold_segment_count = cold_segment_capacity = h->segment_count;
+        cold_segments = (ColdSegment *)checked_malloc((cold_segment_count + 1) * sizeof(ColdSegment));
+        const ReplicaSegment *rs = (const ReplicaSegment *)(base + h->segment_payloads_offset);
+        for (int i = 0; i < cold_segment_count; i++) {
+            ColdSegment *seg = &cold_segments[i];
+            *seg = ((const ColdSegment *)(base + h->segments_offset))[i];
+            seg->id_deltas = (uint8_t *)(base + rs[i].offsets[0]);
+            seg->timestamp_deltas = (uint8_t *)(base + rs[i].offsets[1]);
+            seg->buyer_dict = (int *)(base + rs[i].offsets[2]);
+            seg->seller_dict = (int *)(base + rs[i].offsets[3]);
+            seg->rate_dict = (money_t *)(base + rs[i].offsets[4]);
+            seg->buyer_codes.words = (uint64_t *)(base + rs[i].offsets[5]);
+            seg->seller_codes.words = (uint64_t *)(base + rs[i].offsets[6]);
+            seg->rate_codes.words = (uint64_t *)(base + rs[i].offsets[7]);
+            seg->energy.words = (uint64_t *)(base + rs[i].offsets[8]);
+            seg->price_per_kwh.words = (uint64_t *)(base + rs[i].offsets[9]);
+            seg->total_price.words = (uint64_t *)(base + rs[i].offsets[10]);
+        }
+
+        // Hot trades: the records stay in the mapping, only the trees are local
+        transaction_index = transaction_capacity = h->hot_count;
+        all_transactions = (Transaction **)checked_malloc((transaction_index + 1) * sizeof(Transaction *));
+        Transaction *hot = (Transaction *)(base + h->hot_offset);
+        for (int i = 0; i < transaction_index; i++) {
+            Transaction *t = &hot[i];
+            SellerKey *s = &sellers[find_seller_index(t->seller_id)];
+            BuyerKey *b = &buyers[find_buyer_index(t->buyer_id)];
+            all_transactions[i] = t;
+            global_transaction_tree = insert_transaction(global_transaction_tree, t);
+            s->transaction_tree = insert_transaction(s->transaction_tree, t);
+            b->transaction_tree = insert_transaction(b->transaction_tree, t);
+            index_trade_times(t, datetime_to_minutes(t->datetime), (int)(s - sellers), (int)(b - buyers));
+        }
+        return true;
+    }
+}
+
+// ---------------------------- Benchmarks ----------------------------
+
+// Micro-benchmarks of the B+ tree primitives, run with --bench. Every
+// operation is timed over sequential, reverse and random key orders at the
+// compiled ORDER (build again with -DORDER=n for other fan-outs), and the
+// median of BENCH_REPEATS runs is compared against BENCH_BASELINE_FILE, which
+// --bench-save rewrites for the current ORDER. Keys are generated from a
+// fixed seed so runs are comparable, and the same run serves as a training
+// workload for -fprofile-generate builds.
+
+const char *bench_pattern_names[BENCH_PATTERNS] = {"sequential", "reverse", "random"};
+const char *bench_event_names[BENCH_EVENTS] = {"cycles", "cache misses", "branch misses"};
+
+BenchResult bench_results[BENCH_MAX_RESULTS];
+int bench_result_count = 0;
+bool bench_failed = false;      // A benchmarked tree came out inconsistent
+bool bench_wall_slower = false; // Some wall-time-only comparison was flagged
+
+double bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int bench_open_event(uint64_t config, int group_fd) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+#else
+    (void)config;
+    (void)group_fd;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Opens whichever counters the kernel and hardware allow; wall time is
+// always measured.
+void bench_counters_open(BenchCounters *c) {
+    c->opened = 0;
+    for (int e = 0; e < BENCH_EVENTS; e++) {
+        c->fds[e] = -1;
+        c->slots[e] = -1;
+    }
+#ifdef __linux__
+    uint64_t configs[BENCH_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    c->fds[0] = bench_open_event(configs[0], -1);
+    if (c->fds[0] < 0) {
+        printf("Hardware counters unavailable (perf_event_open: %s); reporting wall time only.\n",
+               strerror(errno));
+        return;
+    }
+    c->slots[0] = c->opened++;
+    for (int e = 1; e < BENCH_EVENTS; e++) {
+        c->fds[e] = bench_open_event(configs[e], c->fds[0]);
+        if (c->fds[e] >= 0) {
+            c->slots[e] = c->opened++;
+        } else {
+            printf("Hardware counter for %s unavailable.\n", bench_event_names[e]);
+        }
+    }
+#else
+    printf("Hardware counters unavailable on this platform; reporting wall time only.\n");
+#endif
+}
+
+void bench_counters_close(BenchCounters *c) {
+    for (int e = 0; e < BENCH_EVENTS; e++) {
+        if (c->fds[e] >= 0) close(c->fds[e]);
+        c->fds[e] = -1;
+    }
+}
+
+void bench_begin(BenchCounters *c, double *start) {
+#ifdef __linux__
+    if (c->opened > 0) {
+        ioctl(c->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(c->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    (void)c;
+#endif
+    *start = bench_now_ns();
+}
+
+void bench_end(BenchCounters *c, double start, BenchSample *sample) {
+    sample->ns = bench_now_ns() - start;
+    for (int e = 0; e < BENCH_EVENTS; e++) sample->events[e] = -1;
+#ifdef __linux__
+    if (c->opened > 0) {
+        ioctl(c->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t values[1 + BENCH_EVENTS];
+        if (read(c->fds[0], values, sizeof(values)) >= (ssize_t)((1 + c->opened) * sizeof(uint64_t))) {
+            for (int e = 0; e < BENCH_EVENTS; e++) {
+                if (c->slots[e] >= 0) sample->events[e] = (int64_t)values[1 + c->slots[e]];
+            }
+        }
+    }
+#else
+    (void)c;
+#endif
+}
+
+int compare_bench_samples(const void *a, const void *b) {
+    double x = ((const BenchSample *)a)->ns, y = ((const BenchSample *)b)->ns;
+    return (x > y) - (x < y);
+}
+
+// Fixed-seed xorshift so every run sees the same random order
+uint64_t bench_next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+void bench_fill_keys(int *keys, int n, BenchPattern pattern) {
+    for (int i = 0; i < n; i++) {
+        keys[i] = pattern == BENCH_REVERSE ? n - 1 - i : i;
+    }
+    if (pattern == BENCH_RANDOM) {
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        for (int i = n - 1; i > 0; i--) {
+            int j = (int)(bench_next_random(&state) % (uint64_t)(i + 1));
+            int tmp = keys[i];
+            keys[i] = keys[j];
+            keys[j] = tmp;
+        }
+    }
+}
+
+// Finds the baseline row for this ORDER, operation and pattern
+bool bench_find_baseline(const char *operation, const char *pattern, BenchSample *baseline) {
+    FILE *file = fopen(BENCH_BASELINE_FILE, "r");
+    if (!file) return false;
+
+    char *line = NULL;
+    size_t capacity = 0;
+    bool found = false;
+    while (!found && getline(&line, &capacity, file) != -1) {
+        if (line[0] == '#') continue;
+        int order;
+        char op[24], pat[12];
+        long long events[BENCH_EVENTS];
+        if (sscanf(line, "%d %23s %11s %lf %lld %lld %lld", &order, op, pat, &baseline->ns,
+                   &events[0], &events[1], &events[2]) != 4 + BENCH_EVENTS) {
+            continue;
+        }
+        if (order == ORDER && strcmp(op, operation) == 0 && strcmp(pat, pattern) == 0) {
+            for (int e = 0; e < BENCH_EVENTS; e++) baseline->events[e] = events[e];
+            found = true;
+        }
+    }
+    free(line);
+    fclose(file);
+    return found;
+}
+
+// Prints the median of `samples` (BENCH_REPEATS runs, reordered) with its
+// change against the baseline. Cycles are compared when both runs have
+// them, wall time otherwise, each against its own threshold. Returns true
+// if cycles got worse by more than that; wall time swings too much between
+// runs on a shared machine, so a slower wall time is only flagged.
+bool bench_report(const char *operation, const char *pattern, long ops, BenchSample *samples) {
+    qsort(samples, BENCH_REPEATS, sizeof(BenchSample), compare_bench_samples);
+    const BenchSample *median = &samples[BENCH_REPEATS / 2];
+    if (bench_result_count < BENCH_MAX_RESULTS) {
+        BenchResult *r = &bench_results[bench_result_count++];
+        snprintf(r->operation, sizeof(r->operation), "%s", operation);
+        snprintf(r->pattern, sizeof(r->pattern), "%s", pattern);
+        r->ops = ops;
+        r->median = *median;
+    }
+
+    printf("%-20s %-11s %9.2f", operation, pattern, median->ns / ops);
+    for (int e = 0; e < BENCH_EVENTS; e++) {
+        if (median->events[e] >= 0) {
+            printf(" %14.3f", (double)median->events[e] / ops);
+        } else {
+            printf(" %14s", "n/a");
+        }
+    }
+
+    BenchSample baseline;
+    bool regressed = false;
+    if (bench_find_baseline(operation, pattern, &baseline)) {
+        double now = median->ns / ops * BENCH_EVENT_SCALE;
+        double then = baseline.ns;
+        bool cycles = median->events[0] >= 0 && baseline.events[0] >= 0;
+        if (cycles) {
+            now = (double)median->events[0] * BENCH_EVENT_SCALE / ops;
+            then = (double)baseline.events[0];
+        }
+        double change = then > 0 ? (now - then) * 100.0 / then : 0;
+        const char *mark = "";
+        if (cycles && change > BENCH_REGRESSION_PERCENT) {
+            regressed = true;
+            mark = "  REGRESSED";
+        } else if (!cycles && change > BENCH_WALL_REGRESSION_PERCENT) {
+            mark = "  slower?";
+            bench_wall_slower = true;
+        }
+        printf("  %+7.1f%%%s\n", change, mark);
+    } else {
+        printf("  %8s\n", "new");
+    }
+    return regressed;
+}
+
+// Rewrites this ORDER's rows of the baseline file, keeping other ORDERs
+bool bench_save_baseline(void) {
+    char temp[64];
+    snprintf(temp, sizeof(temp), "%s.tmp", BENCH_BASELINE_FILE);
+    FILE *out = fopen(temp, "w");
+    if (!out) {
+        printf("Error: Could not write %s\n", temp);
+        return false;
+    }
+    fprintf(out, "# order operation pattern ns_per_op cycles_per_op cache_misses_per_op branch_misses_per_op"
+                 " (per-op figures x%d, -1 if not measured)\n", BENCH_EVENT_SCALE);
+
+    FILE *in = fopen(BENCH_BASELINE_FILE, "r");
+    if (in) {
+        char *line = NULL;
+        size_t capacity = 0;
+        while (getline(&line, &capacity, in) != -1) {
+            int order;
+            if (line[0] == '#' || sscanf(line, "%d", &order) != 1 || order == ORDER) continue;
+            fputs(line, out);
+        }
+        free(line);
+        fclose(in);
+    }
+
+    for (int i = 0; i < bench_result_count; i++) {
+        const BenchResult *r = &bench_results[i];
+        fprintf(out, "%d %s %s %.0f", ORDER, r->operation, r->pattern, r->median.ns * BENCH_EVENT_SCALE / r->ops);
+        for (int e = 0; e < BENCH_EVENTS; e++) {
+            fprintf(out, " %lld", r->median.events[e] >= 0
+                    ? (long long)(r->median.events[e] * BENCH_EVENT_SCALE / r->ops) : -1LL);
+        }
+        fputc('\n', out);
+    }
+    bool ok = fclose(out) == 0 && rename(temp, BENCH_BASELINE_FILE) == 0;
+    if (ok) {
+        printf("Baseline for ORDER %d saved to %s\n", ORDER, BENCH_BASELINE_FILE);
+    } else {
+        printf("Error: Could not save %s\n", BENCH_BASELINE_FILE);
+    }
+    return ok;
+}
+
+double bench_ns_per_op(const char *operation, const char *pattern) {
+    for (int i = 0; i < bench_result_count; i++) {
+        if (strcmp(bench_results[i].operation, operation) == 0 && strcmp(bench_results[i].pattern, pattern) == 0) {
+            return bench_results[i].median.ns / bench_results[i].ops;
+        }
+    }
+    return 0;
+}
+
+bool bench_create_node(BenchCounters *c) {
+    int count = BENCH_KEYS / ORDER;
+    node **nodes = (node **)malloc(count * sizeof(node *));
+    if (!nodes) {
+        printf("Memory allocation failed for benchmark.\n");
+        exit(1);
+    }
+    BenchSample samples[BENCH_REPEATS];
+    double start;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        bench_begin(c, &start);
+        for (int i = 0; i < count; i++) nodes[i] = create_node(true);
+        bench_end(c, start, &samples[r]);
+        for (int i = 0; i < count; i++) free_tree_nodes(nodes[i]);
+    }
+    free(nodes);
+    return bench_report("create_node", "-", count, samples);
+}
+
+// Splits full children of one-child parents; the split includes the
+// create_node() for the new sibling.
+bool bench_split_child(BenchCounters *c, bool leaf) {
+    int count = BENCH_KEYS / ORDER;
+    node **parents = (node **)malloc(count * sizeof(node *));
+    if (!parents) {
+        printf("Memory allocation failed for benchmark.\n");
+        exit(1);
+    }
+    BenchSample samples[BENCH_REPEATS];
+    double start;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        for (int i = 0; i < count; i++) {
+            node *child = create_node(leaf);
+            for (int k = 0; k < ORDER - 1; k++) {
+                child->keys[k] = k;
+                child->pointers[k] = NULL;
+            }
+            child->pointers[ORDER - 1] = NULL;
+            child->num_keys = ORDER - 1;
+            parents[i] = create_node(false);
+            parents[i]->pointers[0] = child;
+            child->parent = parents[i];
+        }
+        bench_begin(c, &start);
+        for (int i = 0; i < count; i++) split_child(parents[i], 0);
+        bench_end(c, start, &samples[r]);
+        for (int i = 0; i < count; i++) free_tree_nodes(parents[i]);
+    }
+    free(parents);
+    return bench_report(leaf ? "split_child/leaf" : "split_child/inner", "-", count, samples);
+}
+
+// Fills one leaf from empty to ORDER - 1 keys over and over, taking keys in
+// pattern order. Reverse order makes every insert shift the whole leaf.
+bool bench_insert_non_full(BenchCounters *c, Transaction *trades, BenchPattern pattern) {
+    int per_leaf = ORDER - 1;
+    int fills = BENCH_KEYS / per_leaf;
+    node *leaf = create_node(true);
+    BenchSample samples[BENCH_REPEATS];
+    double start;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        bench_begin(c, &start);
+        for (int f = 0; f < fills; f++) {
+            leaf->num_keys = 0;
+            Transaction *batch = &trades[f * per_leaf];
+            for (int k = 0; k < per_leaf; k++) insert_non_full(leaf, &batch[k]);
+        }
+        bench_end(c, start, &samples[r]);
+    }
+    free_tree_nodes(leaf);
+    return bench_report("insert_non_full", bench_pattern_names[pattern], (long)fills * per_leaf, samples);
+}
+
+// Builds a whole tree; the last build is returned for the read benchmarks
+node *bench_insert_transaction(BenchCounters *c, Transaction *trades, BenchPattern pattern, bool *regressed) {
+    node *root = NULL;
+    BenchSample samples[BENCH_REPEATS];
+    double start;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        free_tree_nodes(root);
+        root = NULL;
+        bench_begin(c, &start);
+        for (int i = 0; i < BENCH_KEYS; i++) root = insert_transaction(root, &trades[i]);
+        bench_end(c, start, &samples[r]);
+    }
+    *regressed |= bench_report("insert_transaction", bench_pattern_names[pattern], BENCH_KEYS, samples);
+    return root;
+}
+
+bool bench_find_leftmost_leaf(BenchCounters *c, node *root, BenchPattern pattern) {
+    volatile int sink = 0;
+    BenchSample samples[BENCH_REPEATS];
+    double start;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        bench_begin(c, &start);
+        for (int i = 0; i < BENCH_KEYS; i++) sink += find_leftmost_leaf(root)->num_keys;
+        bench_end(c, start, &samples[r]);
+    }
+    (void)sink;
+    return bench_report("find_leftmost_leaf", bench_pattern_names[pattern], BENCH_KEYS, samples);
+}
+
+// Walks the leaf chain reading every transaction, and checks that the walk
+// saw each key once and in order.
+bool bench_leaf_chain(BenchCounters *c, node *root, BenchPattern pattern) {
+    BenchSample samples[BENCH_REPEATS];
+    double start;
+    long long sum = 0;
+    int visited = 0;
+    bool ordered = true;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        sum = 0;
+        visited = 0;
+        ordered = true;
+        int previous = -1;
+        bench_begin(c, &start);
+        for (node *leaf = find_leftmost_leaf(root); leaf != NULL; leaf = leaf->next) {
+            for (int i = 0; i < leaf->num_keys; i++) {
+                int id = ((Transaction *)leaf->pointers[i])->transaction_id;
+                ordered &= id > previous;
+                previous = id;
+                sum += id;
+            }
+            visited += leaf->num_keys;
+        }
+        bench_end(c, start, &samples[r]);
+    }
+    if (visited != BENCH_KEYS || !ordered || sum != (long long)BENCH_KEYS * (BENCH_KEYS - 1) / 2) {
+        printf("Error: %s tree leaf chain is inconsistent (%d of %d keys, %s).\n",
+               bench_pattern_names[pattern], visited, BENCH_KEYS, ordered ? "ordered" : "out of order");
+        bench_failed = true;
+    }
+    return bench_report("leaf_chain", bench_pattern_names[pattern], visited, samples);
+}
+
+// Runs the suite; returns false if anything regressed past its threshold
+// or a benchmarked tree was inconsistent.
+bool run_benchmarks(bool save) {
+    int *keys = (int *)malloc(BENCH_KEYS * sizeof(int));
+    Transaction *trades = (Transaction *)calloc(BENCH_KEYS, sizeof(Transaction));
+    if (!keys || !trades) {
+        printf("Memory allocation failed for benchmark.\n");
+        exit(1);
+    }
+
+    BenchCounters counters;
+    bench_counters_open(&counters);
+    printf("B+ tree micro-benchmarks: ORDER %d, %d keys, median of %d runs\n", ORDER, BENCH_KEYS, BENCH_REPEATS);
+    printf("%-20s %-11s %9s %14s %14s %14s  %8s\n", "operation", "pattern", "ns/op",
+           "cycles/op", "cache-miss/op", "branch-miss/op", "baseline");
+
+    bool regressed = false;
+    regressed |= bench_create_node(&counters);
+    regressed |= bench_split_child(&counters, true);
+    regressed |= bench_split_child(&counters, false);
+    for (int p = 0; p < BENCH_PATTERNS; p++) {
+        bench_fill_keys(keys, BENCH_KEYS, (BenchPattern)p);
+        for (int i = 0; i < BENCH_KEYS; i++) trades[i].transaction_id = keys[i];
+
+        regressed |= bench_insert_non_full(&counters, trades, (BenchPattern)p);
+        node *root = bench_insert_transaction(&counters, trades, (BenchPattern)p, &regressed);
+        regressed |= bench_find_leftmost_leaf(&counters, root, (BenchPattern)p);
+        regressed |= bench_leaf_chain(&counters, root, (BenchPattern)p);
+        free_tree_nodes(root);
+    }
+    bench_counters_close(&counters);
+
+    double ascending = bench_ns_per_op("insert_non_full", "sequential");
+    double ascending_tree = bench_ns_per_op("insert_transaction", "sequential");
+    if (ascending > 0 && ascending_tree > 0) {
+        printf("Descending keys cost %.2fx in insert_non_full and %.2fx in insert_transaction "
+               "relative to ascending keys.\n",
+               bench_ns_per_op("insert_non_full", "reverse") / ascending,
+               bench_ns_per_op("insert_transaction", "reverse") / ascending_tree);
+    }
+    if (regressed) {
+        printf("Slower than baseline where marked REGRESSED (over %.0f%% in cycles).\n",
+               BENCH_REGRESSION_PERCENT);
+    }
+    if (bench_wall_slower) {
+        printf("Without cycle counts, wall time over %.0f%% slower is marked \"slower?\" but does not fail; "
+               "rerun to confirm.\n", BENCH_WALL_REGRESSION_PERCENT);
+    }
+
+    bool ok = !regressed && !bench_failed;
+    if (bench_failed) {
+        printf("Error: A benchmarked tree was inconsistent; results are not valid.\n");
+    } else if (save) {
+        ok = bench_save_baseline();
+    }
+    free(keys);
+    free(trades);
+    return ok;
+}
+
+// ---------------------------- Core Functions ----------------------------
+
+
+
+
+
+
+// Leap year checker
+bool is_leap_year(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
+}
+
+// Helper to extract and convert a number safely from a string range
+int extract_int(const char *str, int start, int len) {
+    int value = 0;
+    for (int i = 0; i < len; i++) {
+        
+        value = value * 10 + (str[start + i] - '0');
+    }
+    return value;
+}
+
+// Main validation function
+bool validate_datetime(const char *datetime) {
+    if (strlen(datetime) != 16) return false;
+    if (datetime[4] != '-' || datetime[7] != '-' || datetime[10] != ' ' || datetime[13] != ':') 
+        return false;
+
+    int year   = extract_int(datetime, 0, 4);
+    int month  = extract_int(datetime, 5, 2);
+    int day    = extract_int(datetime, 8, 2);
+    int hour   = extract_int(datetime, 11, 2);
+    int minute = extract_int(datetime, 14, 2);
+
+    if (year < 1) return false;                    // Year must be positive
+    if (month < 1 || month > 12) return false;
+    if (hour < 0 || hour > 23) return false;
+    if (minute < 0 || minute > 59) return false;
+
+    int days_in_month[] = { 31,28,31,30,31,30,31,31,30,31,30,31 };
+    if (is_leap_year(year)) days_in_month[1] = 29;
+
+    if (day < 1 || day > days_in_month[month - 1]) return false;
+
+    return true;
+}
+
+// Pointers returned by get_or_create_seller()/get_or_create_buyer() stay
+// valid until the next participant of the same kind is created.
+SellerKey* get_or_create_seller(int seller_id, money_t rate_below_300, money_t rate_above_300) {
+    SellerKey *s = find_seller(seller_id);
+    if (s) {
+        // Update rates if provided
+        if (rate_below_300 > 0) s->rate_below_300 = rate_below_300;
+        if (rate_above_300 > 0) s->rate_above_300 = rate_above_300;
+        return s;
+    }
+
+    // Seller not found - intern the id and append a new record
+    int seller_order_capacity = seller_capacity;
+    sellers = (SellerKey *)grow_array(sellers, &seller_capacity, seller_count + 1, sizeof(SellerKey));
+    if (seller_capacity != seller_order_capacity) {
+        seller_order = (int *)realloc(seller_order, seller_capacity * sizeof(int));
+        if (!seller_order) {
+            printf("Memory allocation failed for seller order.\n");
+            exit(1);
+        }
+    }
+
+    SellerKey *new_seller = &sellers[seller_count];
+    new_seller->seller_id = seller_id;
+    new_seller->rate_below_300 = rate_below_300;
+    new_seller->rate_above_300 = rate_above_300;
+    new_seller->transaction_tree = NULL;
+    new_seller->transaction_count = 0;
+    new_seller->sealed_revenue = 0;
+    new_seller->sealed_energy = 0;
+
+    idmap_put(&seller_ids, (uint64_t)(uint32_t)seller_id, seller_count);
+    seller_count++;
+    seller_order_dirty = true;
+    report_cache_invalidate_kind(REPORT_REVENUE_BY_SELLER);
+    return new_seller;
+}
+BuyerKey* get_or_create_buyer(int buyer_id) {
+    int index = find_buyer_index(buyer_id);
+    if (index >= 0) {
+        return &buyers[index];
+    }
+
+    // Buyer not found - intern the id and append a new record
+    int buyer_order_capacity = buyer_capacity;
+    buyers = (BuyerKey *)grow_array(buyers, &buyer_capacity, buyer_count + 1, sizeof(BuyerKey));
+    if (buyer_capacity != buyer_order_capacity) {
+        buyer_order = (int *)realloc(buyer_order, buyer_capacity * sizeof(int));
+        if (!buyer_order) {
+            printf("Memory allocation failed for buyer order.\n");
+            exit(1);
+        }
+    }
+
+    BuyerKey *new_buyer = &buyers[buyer_count];
+    new_buyer->buyer_id = buyer_id;
+    new_buyer->total_energy_purchased = 0;
+    new_buyer->transaction_tree = NULL;
+    new_buyer->transaction_count = 0;
+
+    idmap_put(&buyer_ids, (uint64_t)(uint32_t)buyer_id, buyer_count);
+    buyer_count++;
+    buyer_order_dirty = true;
+    report_cache_invalidate_kind(REPORT_BUYERS_BY_ENERGY);
+    return new_buyer;
+}
+money_t calculate_price(SellerKey *s, energy_t energy_kwh, int buyer_id) {
+    money_t total_price = 0;
+    
+    // Check if buyer is a regular customer
+    bool is_regular = false;
+    int buyer_index = find_buyer_index(buyer_id);
+    if (buyer_index >= 0) {
+        PairStats *p = find_pair(buyer_index, (int)(s - sellers));
+        is_regular = p != NULL && p->is_regular;
+    }
+    
+    // Calculate price based on tiered rates
+    if (energy_kwh <= ENERGY_THRESHOLD) {
+        total_price = energy_cost(energy_kwh, s->rate_below_300);
+    } else {
+        total_price = energy_cost(ENERGY_THRESHOLD, s->rate_below_300);
+        total_price += energy_cost(energy_kwh - ENERGY_THRESHOLD, s->rate_above_300);
+    }
+    
+    // Apply 5% discount for regular customers
+    if (is_regular) {
+        total_price = div_round(total_price * (100 - REGULAR_DISCOUNT_PERCENT), 100);
+    }
+    
+    return total_price;
+}
+
+// Prices a new trade: the effective rate per kWh across both tiers, and the
+// total after any regular-customer discount. Live entry and journal replay
+// both go through here so they store the same values.
+void price_transaction(Transaction *t, SellerKey *s) {
+    if (t->energy_kwh <= ENERGY_THRESHOLD) {
+        t->price_per_kwh = s->rate_below_300;
+    } else {
+        money_t below_price = energy_cost(ENERGY_THRESHOLD, s->rate_below_300);
+        money_t above_price = energy_cost(t->energy_kwh - ENERGY_THRESHOLD, s->rate_above_300);
+        t->price_per_kwh = div_round((below_price + above_price) * ENERGY_SCALE, t->energy_kwh);
+    }
+    t->total_price = calculate_price(s, t->energy_kwh, t->buyer_id);
+}
+
+// Updates the (buyer, seller) pair statistics for a newly indexed trade
+PairStats *record_pair_trade(BuyerKey *b, SellerKey *s, int transaction_id) {
+    PairStats *p = get_or_create_pair((int)(b - buyers), (int)(s - sellers));
+    if (p->transaction_count == 0 || transaction_id < p->first_transaction_id) {
+        p->first_transaction_id = transaction_id;
+    }
+    p->transaction_count++;
+    return p;
+}
+
+bool add_transaction(Transaction *t) {
+    if (!idset_add(&transaction_ids, t->transaction_id)) {
+        printf("Transaction already exists. Try again!");
+        return false;
+    }
+    all_transactions = (Transaction **)grow_array(all_transactions, &transaction_capacity,
+                                                  transaction_index + 1, sizeof(Transaction *));
+    all_transactions[transaction_index++] = t;
+    note_hot_timestamp(t);
+    report_cache_note_trade(t);
+    global_transaction_tree = insert_transaction(global_transaction_tree, t);
+
+    // Use the new B+ tree versions
+    SellerKey *s = get_or_create_seller(t->seller_id, t->rate_below_300, t->rate_above_300);
+    s->transaction_tree = insert_transaction(s->transaction_tree, t);
+    s->transaction_count++;
+
+    BuyerKey *b = get_or_create_buyer(t->buyer_id);
+    b->transaction_tree = insert_transaction(b->transaction_tree, t);
+    b->total_energy_purchased += t->energy_kwh;
+    b->transaction_count++;
+    index_trade_times(t, datetime_to_minutes(t->datetime), (int)(s - sellers), (int)(b - buyers));
+
+    PairStats *p = record_pair_trade(b, s, t->transaction_id);
+    if (b->transaction_count > REGULAR_CUSTOMER_THRESHOLD && !p->is_regular) {
+        p->is_regular = true;
+        printf("Buyer %d is now a regular customer of Seller %d!\n", b->buyer_id, s->seller_id);
+    }
+
+    trades_since_checkpoint++;
+    sketch_note_trade(t);
+
+    // May seal `t` itself if it was back-dated past the cold cutoff
+    maybe_seal_cold_transactions();
+    return true;
+}
+
+void display_all_transactions() {
+    printf("\nAll Transactions:\n");
+    printf("%-5s %-8s %-8s %-12s %-12s %-12s %-20s\n", 
+           "ID", "Buyer", "Seller", "Energy(kWh)", "Price/kWh", "Total($)", "Time");
+    printf("-----------------------------------------------------------------------\n");
+    
+    // Streamed rather than built whole, since this can be every trade
+    ReportWriter writer;
+    report_writer_open(&writer, STDOUT_FILENO);
+    TransactionCursor cursor;
+    cursor_open(&cursor, global_transaction_tree, no_filter());
+    const Transaction *t;
+    while ((t = cursor_next(&cursor)) != NULL) {
+        report_transaction_row(&writer.buf, t, true);
+        report_writer_row_done(&writer);
+    }
+    cursor_close(&cursor);
+    report_writer_close(&writer);
+}
+
+// Context of the per-participant transaction reports
+typedef struct ParticipantReport {
+    const int *order;           // Participant indices in id order
+    ColdRowIndex cold;
+} ParticipantReport;
+
+void render_seller_transactions(int task, ReportBuffer *out, void *ctx) {
+    const ParticipantReport *report = (const ParticipantReport *)ctx;
+    int seller_index = report->order[task];
+    SellerKey *s = &sellers[seller_index];
+    
+    char below[32], above[32];
+    report_printf(out, "\nSeller %d:\n", s->seller_id);
+    report_printf(out, "Rates: %s$/kWh (≤300kWh), %s$/kWh (>300kWh)\n", 
+                  format_money(below, s->rate_below_300), format_money(above, s->rate_above_300));
+    
+    // Print transactions for this seller, hot and sealed
+    const int *starts = report->cold.starts;
+    TransactionCursor cursor;
+    cursor_open_refs(&cursor, s->transaction_tree, report->cold.refs + starts[seller_index],
+                     starts[seller_index + 1] - starts[seller_index]);
+    const Transaction *t;
+    while ((t = cursor_next(&cursor)) != NULL) {
+        char *p = report_reserve(out, REPORT_MAX_ROW_BYTES);
+        p = put_str(p, "Transaction ID: ");
+        p = put_int(p, t->transaction_id);
+        p = put_str(p, ", Buyer: ");
+        p = put_int(p, t->buyer_id);
+        p = put_str(p, ", Energy: ");
+        p = put_fixed(p, t->energy_kwh, ENERGY_SCALE, 2);
+        p = put_str(p, " kWh\n");
+        report_commit(out, p);
+    }
+    cursor_close(&cursor);
+}
+
+void transactions_by_seller() {
+    ReportBuffer out = {0};
+    report_printf(&out, "\nTransactions by Seller:\n");
+    
+    // One task per seller, stitched back together in seller_id order
+    ParticipantReport report = { sellers_in_id_order(), {0} };
+    cold_index_build(&report.cold, true);
+    render_parallel(seller_count, render_seller_transactions, &report, &out);
+    cold_index_free(&report.cold);
+    report_write(&out);
+}
+
+void render_buyer_transactions(int task, ReportBuffer *out, void *ctx) {
+    const ParticipantReport *report = (const ParticipantReport *)ctx;
+    int buyer_index = report->order[task];
+    BuyerKey *b = &buyers[buyer_index];
+    
+    char bought[32];
+    report_printf(out, "\nBuyer %d (Total Energy: %s kWh, Transactions: %d):\n", 
+                  b->buyer_id, format_energy(bought, b->total_energy_purchased), b->transaction_count);
+    
+    report_printf(out, "%-5s %-8s %-12s %-12s %-12s %-20s\n", 
+                  "ID", "Seller", "Energy(kWh)", "Price/kWh", "Total($)", "Time");
+    report_printf(out, "-----------------------------------------------------------------\n");
+    
+    // Now display all transactions for this buyer
+    const int *starts = report->cold.starts;
+    TransactionCursor cursor;
+    cursor_open_refs(&cursor, b->transaction_tree, report->cold.refs + starts[buyer_index],
+                     starts[buyer_index + 1] - starts[buyer_index]);
+    const Transaction *t;
+    while ((t = cursor_next(&cursor)) != NULL) {
+        char *p = report_reserve(out, REPORT_MAX_ROW_BYTES);
+        char *f = p;
+        p = pad_to(f, put_int(p, t->transaction_id), 5); *p++ = ' '; f = p;
+        p = pad_to(f, put_int(p, t->seller_id), 8); *p++ = ' '; f = p;
+        p = pad_to(f, put_fixed(p, t->energy_kwh, ENERGY_SCALE, 2), 12); *p++ = ' '; f = p;
+        p = pad_to(f, put_fixed(p, t->price_per_kwh, MONEY_SCALE, 2), 12); *p++ = ' '; f = p;
+        p = pad_to(f, put_fixed(p, t->total_price, MONEY_SCALE, 2), 12); *p++ = ' ';
+        p = put_str(p, t->datetime);
+        *p++ = '\n';
+        report_commit(out, p);
+    }
+    cursor_close(&cursor);
+}
+
+void transactions_by_buyer() {
+    ReportBuffer out = {0};
+    report_printf(&out, "\nTransactions by Buyer:\n");
+    
+    // One task per buyer, stitched back together in buyer_id order
+    ParticipantReport report = { buyers_in_id_order(), {0} };
+    cold_index_build(&report.cold, false);
+    render_parallel(buyer_count, render_buyer_transactions, &report, &out);
+    cold_index_free(&report.cold);
+    report_write(&out);
+}
+
+void render_seller_revenue(int task, ReportBuffer *out, void *ctx) {
+    SellerKey *s = &sellers[((const int *)ctx)[task]];
+    money_t revenue = s->sealed_revenue;
+    energy_t total_energy = s->sealed_energy;
+    
+    // Add the hot trades by traversing the seller's transaction tree
+    node *trans_leaf = find_leftmost_leaf(s->transaction_tree);
+    while (trans_leaf != NULL) {
+        for (int j = 0; j < trans_leaf->num_keys; j++) {
+            Transaction *t = (Transaction *)trans_leaf->pointers[j];
+            revenue += t->total_price;
+            total_energy += t->energy_kwh;
+        }
+        trans_leaf = trans_leaf->next;
+    }
+    
+    char revenue_str[32], energy_str[32];
+    report_printf(out, "%-8d %-15s %-15s %-15d\n", 
+                  s->seller_id, format_money(revenue_str, revenue),
+                  format_energy(energy_str, total_energy), s->transaction_count);
+}
+
+void total_revenue_by_seller() {
+    ReportKey key = { REPORT_REVENUE_BY_SELLER, 0, 0 };
+    if (report_cache_replay(&key)) return;
+
+    ReportBuffer out = {0};
+    report_printf(&out, "\nTotal Revenue by Seller:\n");
+    report_printf(&out, "%-8s %-15s %-15s %-15s\n", 
+                        "Seller", "Revenue($)", "Energy(kWh)", "Transactions");
+    report_printf(&out, "--------------------------------------------------\n");
+    
+    // Sealed trades are pre-summed per seller; only the hot trees are walked
+    render_parallel(seller_count, render_seller_revenue, (void *)sellers_in_id_order(), &out);
+
+    report_emit(&key, &out);
+}
+void energy_range_transactions(energy_t min_kwh, energy_t max_kwh) {
+    ReportKey key = { REPORT_ENERGY_RANGE, min_kwh, max_kwh };
+    if (report_cache_replay(&key)) return;
+
+    ReportBuffer out = {0};
+    char min_str[32], max_str[32];
+    report_printf(&out, "\nTransactions in Energy Range %s - %s kWh:\n",
+                        format_energy(min_str, min_kwh), format_energy(max_str, max_kwh));
+    report_printf(&out, "%-5s %-8s %-8s %-12s %-12s %-12s\n", 
+                        "ID", "Buyer", "Seller", "Energy(kWh)", "Price/kWh", "Total($)");
+    report_printf(&out, "--------------------------------------------------------------\n");
+    
+    TransactionFilter filter = no_filter();
+    filter.min_energy = min_kwh;
+    filter.max_energy = max_kwh;
+    TransactionCursor cursor;
+    cursor_open(&cursor, global_transaction_tree, filter);
+    const Transaction *t;
+    while ((t = cursor_next(&cursor)) != NULL) {
+        if (t->energy_kwh >= min_kwh && t->energy_kwh <= max_kwh) {
+            report_transaction_row(&out, t, false);
+        }
+    }
+    cursor_close(&cursor);
+
+    report_emit(&key, &out);
+}
+
+// LSD radix sort on the fixed-point energy, one byte per pass. The sign
+// bit is flipped so negative totals order before positive ones.
+void radix_sort_buyers_by_energy(BuyerKey **items, int count) {
+    BuyerKey **scratch = (BuyerKey **)malloc((count + 1) * sizeof(BuyerKey *));
+    if (!scratch) {
+        printf("Memory allocation failed for radix sort.\n");
+        exit(1);
+    }
+
+    BuyerKey **src = items;
+    BuyerKey **dst = scratch;
+    for (int shift = 0; shift < 64; shift += 8) {
+        int counts[257] = {0};
+        for (int i = 0; i < count; i++) {
+            uint64_t key = (uint64_t)src[i]->total_energy_purchased ^ (1ULL << 63);
+            counts[((key >> shift) & 0xFF) + 1]++;
+        }
+        // Skip passes where every key shares the same byte
+        bool trivial = false;
+        for (int b = 1; b <= 256; b++) {
+            if (counts[b] == count) trivial = true;
+        }
+        if (trivial) continue;
+
+        for (int b = 1; b <= 256; b++) counts[b] += counts[b - 1];
+        for (int i = 0; i < count; i++) {
+            uint64_t key = (uint64_t)src[i]->total_energy_purchased ^ (1ULL << 63);
+            dst[counts[(key >> shift) & 0xFF]++] = src[i];
+        }
+        BuyerKey **tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != items) {
+        memcpy(items, src, count * sizeof(BuyerKey *));
+    }
+    free(scratch);
+}
+
+void sort_buyers_by_energy() {
+    ReportKey key = { REPORT_BUYERS_BY_ENERGY, 0, 0 };
+    if (report_cache_replay(&key)) return;
+
+    ReportBuffer out = {0};
+    report_printf(&out, "\nBuyers Sorted by Total Energy Purchased:\n");
+    report_printf(&out, "%-8s %-15s %-15s\n", "Buyer", "Energy(kWh)", "Transactions");
+    report_printf(&out, "----------------------------------------\n");
+
+    // First, collect all buyers into an array for sorting
+    BuyerKey **sorted = (BuyerKey **)checked_malloc((buyer_count + 1) * sizeof(BuyerKey *));
+
+    const int *order = buyers_in_id_order();
+    for (int i = 0; i < buyer_count; i++) {
+        sorted[i] = &buyers[order[i]];
+    }
+
+    // Stable radix sort keeps buyers with equal energy in buyer_id order
+    radix_sort_buyers_by_energy(sorted, buyer_count);
+
+    // Display sorted results
+    for (int i = 0; i < buyer_count; i++) {
+        char energy[32];
+        report_printf(&out, "%-8d %-15s %-15d\n", 
+                            sorted[i]->buyer_id, 
+                            format_energy(energy, sorted[i]->total_energy_purchased),
+                            sorted[i]->transaction_count);
+    }
+    free(sorted);
+
+    report_emit(&key, &out);
+}
+
+// Most trades first; ties keep the buyer_id / first-trade order the pairs
+// are discovered in when walking each buyer's transactions
+int compare_pairs_by_count(const void *a, const void *b) {
+    const PairStats *x = *(const PairStats * const *)a;
+    const PairStats *y = *(const PairStats * const *)b;
+    if (x->transaction_count != y->transaction_count) {
+        return y->transaction_count - x->transaction_count;
+    }
+    int xb = buyers[x->buyer_index].buyer_id;
+    int yb = buyers[y->buyer_index].buyer_id;
+    if (xb != yb) return (xb > yb) - (xb < yb);
+    return (x->first_transaction_id > y->first_transaction_id) -
+           (x->first_transaction_id < y->first_transaction_id);
+}
+
+void sort_pairs_by_transaction_count() {
+    ReportKey key = { REPORT_PAIRS_BY_COUNT, 0, 0 };
+    if (report_cache_replay(&key)) return;
+
+    ReportBuffer out = {0};
+    report_printf(&out, "\nBuyer/Seller Pairs by Number of Transactions:\n");
+    report_printf(&out, "%-8s %-8s %-15s\n", "Buyer", "Seller", "Transactions");
+    report_printf(&out, "--------------------------------\n");
+
+    // Collect the pairs that have traded at least once
+    PairStats **ranked = (PairStats **)checked_malloc((pair_count + 1) * sizeof(PairStats *));
+
+    int ranked_count = 0;
+    for (int i = 0; i < pair_count; i++) {
+        if (pairs[i].transaction_count > 0) {
+            ranked[ranked_count++] = &pairs[i];
+        }
+    }
+
+    qsort(ranked, ranked_count, sizeof(PairStats *), compare_pairs_by_count);
+
+    // Display results
+    for (int i = 0; i < ranked_count; i++) {
+        report_printf(&out, "%-8d %-8d %-15d\n", 
+                            buyers[ranked[i]->buyer_index].buyer_id, 
+                            sellers[ranked[i]->seller_index].seller_id, 
+                            ranked[i]->transaction_count);
+    }
+    free(ranked);
+
+    report_emit(&key, &out);
+}
+
+void transactions_in_time_range(const char *start_str, const char *end_str) {
+    ReportKey key = { REPORT_TIME_RANGE, datetime_to_minutes(start_str), datetime_to_minutes(end_str) };
+    if (report_cache_replay(&key)) return;
+
+    ReportBuffer out = {0};
+    report_printf(&out, "\nTransactions from %s to %s:\n", start_str, end_str);
+    report_printf(&out, "%-5s %-8s %-8s %-12s %-12s %-12s %-20s\n", 
+                        "ID", "Buyer", "Seller", "Energy(kWh)", "Price/kWh", "Total($)", "Time");
+    report_printf(&out, "---------------------------------------------------------------------------------\n");
+    
+    TransactionFilter filter = no_filter();
+    filter.min_timestamp = datetime_to_minutes(start_str);
+    filter.max_timestamp = datetime_to_minutes(end_str);
+    TransactionCursor cursor;
+    cursor_open(&cursor, global_transaction_tree, filter);
+    const Transaction *t;
+    while ((t = cursor_next(&cursor)) != NULL) {
+        if (strcmp(t->datetime, start_str) >= 0 && strcmp(t->datetime, end_str) <= 0) {
+            report_transaction_row(&out, t, true);
+        }
+    }
+    cursor_close(&cursor);
+
+    report_emit(&key, &out);
+}
+
+int compare_trades_by_time(const void *a, const void *b) {
+    const Transaction *x = (const Transaction *)a;
+    const Transaction *y = (const Transaction *)b;
+    int c = strcmp(x->datetime, y->datetime);
+    if (c != 0) return c;
+    return (x->transaction_id > y->transaction_id) - (x->transaction_id < y->transaction_id);
+}
+
+// One participant's trades in [from, to], oldest first. Hot trades come
+// from the time index in O(log n + k); sealed ones from the segments whose
+// zone maps and dictionaries admit the participant and the window.
+void render_participant_window(ReportBuffer *out, TimeNode *index, int participant,
+                               bool by_seller, int64_t from, int64_t to) {
+    TransactionFilter filter = no_filter();
+    if (by_seller) filter.seller_index = participant;
+    else filter.buyer_index = participant;
+    filter.min_timestamp = from;
+    filter.max_timestamp = to;
+
+    Transaction *cold = NULL;
+    int cold_count = 0, cold_capacity = 0;
+    TransactionCursor cursor;
+    cursor_open(&cursor, NULL, filter);
+    const Transaction *t;
+    while ((t = cursor_next(&cursor)) != NULL) {
+        cold = (Transaction *)grow_array(cold, &cold_capacity, cold_count + 1, sizeof(Transaction));
+        cold[cold_count++] = *t;
+    }
+    cursor_close(&cursor);
+    qsort(cold, cold_count, sizeof(Transaction), compare_trades_by_time);
+
+    TimeIndexScan scan;
+    time_scan_open(&scan, index, participant, from, to);
+    Transaction *hot = time_scan_next(&scan);
+    int next_cold = 0;
+    while (hot || next_cold < cold_count) {
+        if (hot && (next_cold == cold_count || compare_trades_by_time(hot, &cold[next_cold]) < 0)) {
+            t = hot;
+            hot = time_scan_next(&scan);
+        } else {
+            t = &cold[next_cold++];
+        }
+
+        char *p = report_reserve(out, REPORT_MAX_ROW_BYTES);
+        char *f = p;
+        p = pad_to(f, put_int(p, t->transaction_id), 5); *p++ = ' '; f = p;
+        p = pad_to(f, put_int(p, by_seller ? t->buyer_id : t->seller_id), 8); *p++ = ' '; f = p;
+        p = pad_to(f, put_fixed(p, t->energy_kwh, ENERGY_SCALE, 2), 12); *p++ = ' '; f = p;
+        p = pad_to(f, put_fixed(p, t->price_per_kwh, MONEY_SCALE, 2), 12); *p++ = ' '; f = p;
+        p = pad_to(f, put_fixed(p, t->total_price, MONEY_SCALE, 2), 12); *p++ = ' ';
+        p = put_str(p, t->datetime);
+        *p++ = '\n';
+        report_commit(out, p);
+    }
+    free(cold);
+}
+
+void seller_transactions_in_time_range(int seller_id, const char *start_str, const char *end_str) {
+    int seller_index = find_seller_index(seller_id);
+    if (seller_index < 0) {
+        printf("Seller %d not found.\n", seller_id);
+        return;
+    }
+
+    ReportBuffer out = {0};
+    report_printf(&out, "\nSeller %d Transactions from %s to %s:\n", seller_id, start_str, end_str);
+    report_printf(&out, "%-5s %-8s %-12s %-12s %-12s %-20s\n", 
+                        "ID", "Buyer", "Energy(kWh)", "Price/kWh", "Total($)", "Time");
+    report_printf(&out, "-----------------------------------------------------------------\n");
+    render_participant_window(&out, seller_time_index, seller_index, true,
+                              datetime_to_minutes(start_str), datetime_to_minutes(end_str));
+    report_write(&out);
+}
+
+void buyer_transactions_in_time_range(int buyer_id, const char *start_str, const char *end_str) {
+    int buyer_index = find_buyer_index(buyer_id);
+    if (buyer_index < 0) {
+        printf("Buyer %d not found.\n", buyer_id);
+        return;
+    }
+
+    ReportBuffer out = {0};
+    report_printf(&out, "\nBuyer %d Transactions from %s to %s:\n", buyer_id, start_str, end_str);
+    report_printf(&out, "%-5s %-8s %-12s %-12s %-12s %-20s\n", 
+                        "ID", "Seller", "Energy(kWh)", "Price/kWh", "Total($)", "Time");
+    report_printf(&out, "-----------------------------------------------------------------\n");
+    render_participant_window(&out, buyer_time_index, buyer_index, false,
+                              datetime_to_minutes(start_str), datetime_to_minutes(end_str));
+    report_write(&out);
+}
+
+// Formats one CSV row into buf (PERSIST_MAX_ROW_BYTES long); returns its length
+size_t format_transaction_row(char *buf, const Transaction *t) {
+    return put_csv_row(buf, t) - buf;
+}
+
+// Dumps every trade, hot and sealed, in transaction_id order
+void export_transactions(const char *path, ReportFormat format) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("Error: Could not create %s\n", path);
+        return;
+    }
+
+    ReportWriter writer;
+    report_writer_open(&writer, fd);
+    char *p = writer.buf.data;
+    if (format == FORMAT_CSV) {
+        p = put_str(p, TRANSACTIONS_HEADER "\n");
+    } else if (format == FORMAT_BINARY) {
+        p = put_str(p, BINARY_EXPORT_MAGIC);
+        p = put_le(p, BINARY_EXPORT_VERSION, 4);
+        p = put_le(p, BINARY_RECORD_BYTES, 4);
+    }
+    report_commit(&writer.buf, p);
+
+    int exported = 0;
+    TransactionCursor cursor;
+    cursor_open(&cursor, global_transaction_tree, no_filter());
+    const Transaction *t;
+    while ((t = cursor_next(&cursor)) != NULL) {
+        p = writer.buf.data + writer.buf.length;
+        switch (format) {
+            case FORMAT_CSV: p = put_csv_row(p, t); break;
+            case FORMAT_JSON_LINES: p = put_json_row(p, t); break;
+            case FORMAT_BINARY: p = put_binary_row(p, t); break;
+        }
+        report_commit(&writer.buf, p);
+        report_writer_row_done(&writer);
+        exported++;
+    }
+    cursor_close(&cursor);
+
+    report_writer_close(&writer);
+    if (close(fd) != 0) writer.failed = true;
+    if (writer.failed) {
+        printf("Error: Could not write %s\n", path);
+        return;
+    }
+    printf("Exported %d transactions to %s\n", exported, path);
+}
+
+// Parses "id,buyer,seller,energy,rate_below,rate_above,datetime" without
+// going through scanf's float conversion. Returns the number of fields
+// read, like sscanf, so callers can report malformed lines.
+int parse_transaction_line(const char *line, Transaction *t, char datetime_str[20]) {
+    const char *p = line;
+    int fields = 0;
+
+    if (!(p = parse_int(p, &t->transaction_id))) return fields;
+    fields++;
+    if (*p++ != ',' || !(p = parse_int(p, &t->buyer_id))) return fields;
+    fields++;
+    if (*p++ != ',' || !(p = parse_int(p, &t->seller_id))) return fields;
+    fields++;
+    if (*p++ != ',' || !(p = parse_fixed(p, ENERGY_SCALE, &t->energy_kwh))) return fields;
+    fields++;
+    if (*p++ != ',' || !(p = parse_fixed(p, MONEY_SCALE, &t->rate_below_300))) return fields;
+    fields++;
+    if (*p++ != ',' || !(p = parse_fixed(p, MONEY_SCALE, &t->rate_above_300))) return fields;
+    fields++;
+    if (*p++ != ',') return fields;
+
+    int len = 0;
+    while (p[len] != '\0' && p[len] != ',' && len < 19) {
+        datetime_str[len] = p[len];
+        len++;
+    }
+    datetime_str[len] = '\0';
+    if (len == 0) return fields;
+    return fields + 1;
+}
+
+void load_transactions_from_file() {
+    FILE *file = fopen(TRANSACTIONS_FILE, "r");
+    if (file == NULL) {
+        printf("Info: No existing transaction file found. Starting fresh.\n");
+        return;
+    }
+
+    printf("Loading transactions from file...\n");
+    char *line = NULL;          // Seller lines grow with their regular buyers
+    size_t line_size = 0;
+    ssize_t line_length = 0;
+    bool last_line_complete = true;  // Whether the last line read ended in a newline
+    int line_num = 0;
+    int loaded_count = 0;
+    int skipped_count = 0;
+    bool loading_sellers = false;
+
+    // Only what was appended after the checkpoint needs replaying
+    int64_t journal_offset;
+    if (load_checkpoint(file, &journal_offset, &line_num, &loading_sellers)) {
+        fseek(file, journal_offset, SEEK_SET);
+        printf("Restored checkpoint: %d hot and %d sealed transactions; replaying from line %d.\n",
+               transaction_index, cold_row_count, line_num + 1);
+    }
+
+    while ((line_length = getline(&line, &line_size, file)) != -1) {
+        line_num++;
+        last_line_complete = line[line_length - 1] == '\n';
+
+        // Skip empty lines or comments
+        if (line[0] == '\n' || line[0] == '#') {
+            if (strstr(line, "# Sellers")) {
+                loading_sellers = true;
+            } else if (strstr(line, "# Transactions")) {
+                // Rows appended after a seller section
+                loading_sellers = false;
+            }
+            continue;
+        }
+
+        // Remove newline character (files edited on Windows end in "\r\n")
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (!loading_sellers) {
+            // Parse transaction line
+            Transaction t;
+            char datetime_str[20];
+            int matched = parse_transaction_line(line, &t, datetime_str);
+
+            if (matched != 7) {
+                printf("Line %d: Skipped transaction - Malformed (fields=%d)\n", line_num, matched);
+                skipped_count++;
+                continue;
+            }
+
+            if (!validate_datetime(datetime_str)) {
+                printf("Line %d: Skipped - Invalid datetime format: %s\n", line_num, datetime_str);
+                skipped_count++;
+                continue;
+            }
+
+            strncpy(t.datetime, datetime_str, sizeof(t.datetime));
+
+            // Check for duplicate transaction ID
+            if (idset_contains(&transaction_ids, t.transaction_id)) {
+                printf("Line %d: Skipped - Duplicate transaction ID %d\n", line_num, t.transaction_id);
+                skipped_count++;
+                continue;
+            }
+
+            // Create seller if needed
+            SellerKey *s = get_or_create_seller(t.seller_id, t.rate_below_300, t.rate_above_300);
+
+            price_transaction(&t, s);
+
+            // Create transaction
+            Transaction *new_t = (Transaction *)malloc(sizeof(Transaction));
+            if (!new_t) {
+                printf("Line %d: Error - Memory allocation failed\n", line_num);
+                skipped_count++;
+                continue;
+            }
+            *new_t = t;
+            idset_add(&transaction_ids, new_t->transaction_id);
+
+            // Add to trees
+            all_transactions = (Transaction **)grow_array(all_transactions, &transaction_capacity,
+                                                          transaction_index + 1, sizeof(Transaction *));
+            all_transactions[transaction_index++] = new_t;
+            note_hot_timestamp(new_t);
+            global_transaction_tree = insert_transaction(global_transaction_tree, new_t);
+            
+            s->transaction_tree = insert_transaction(s->transaction_tree, new_t);
+            s->transaction_count++;
+
+            BuyerKey *b = get_or_create_buyer(t.buyer_id);
+            b->transaction_tree = insert_transaction(b->transaction_tree, new_t);
+            b->total_energy_purchased += t.energy_kwh;
+            b->transaction_count++;
+            index_trade_times(new_t, datetime_to_minutes(new_t->datetime), (int)(s - sellers), (int)(b - buyers));
+            // Same promotion rule as add_transaction(), so the journal alone
+            // reproduces the regular flags
+            PairStats *p = record_pair_trade(b, s, t.transaction_id);
+            if (b->transaction_count > REGULAR_CUSTOMER_THRESHOLD) {
+                p->is_regular = true;
+            }
+            sketch_note_trade(new_t);
+            maybe_seal_cold_transactions();
+
+            loaded_count++;
+        } else {
+            // Parse seller information
+            int seller_id;
+            money_t rate_below, rate_above;
+            int regular_count;
+            char *token = strtok(line, ",");
+            
+            if (token == NULL) continue;
+            seller_id = atoi(token);
+            
+            token = strtok(NULL, ",");
+            if (token == NULL || !parse_fixed(token, MONEY_SCALE, &rate_below)) continue;
+            
+            token = strtok(NULL, ",");
+            if (token == NULL || !parse_fixed(token, MONEY_SCALE, &rate_above)) continue;
+            
+            token = strtok(NULL, ",");
+            if (token == NULL) continue;
+            regular_count = atoi(token);
+            
+            SellerKey *s = get_or_create_seller(seller_id, rate_below, rate_above);
+            int seller_index = (int)(s - sellers);
+            
+            for (int i = 0; i < regular_count; i++) {
+                token = strtok(NULL, ",");
+                if (token == NULL) break;
+                BuyerKey *b = get_or_create_buyer(atoi(token));
+                get_or_create_pair((int)(b - buyers), seller_index)->is_regular = true;
+            }
+        }
+    }
+
+    // A last line without a newline is not counted as a full one
+    journal_known_bytes = ftell(file);
+    journal_known_lines = line_num;
+    if (!last_line_complete) journal_known_lines--;
+    journal_replayed_trades = loaded_count;
+    free(line);
+    fclose(file);
+    file_ends_in_sellers = loading_sellers;
+
+    // Seal whatever history is already past the cutoff
+    seal_cold_transactions();
+    if (cold_row_count > 0) {
+        print_storage_stats();
+    }
+}
+// ---------------------------- Persistence ----------------------------
+
+// Committed trades are appended to TRANSACTIONS_FILE off the interactive
+// path. The operator thread pushes copies into a lock-free single-producer
+// ring; a formatter thread turns them into CSV rows in the front buffer
+// while a writer thread write()s and fsync()s the back buffer.
+
+// Wakes the formatter if it went to sleep on an empty queue
+void persistence_wake_formatter() {
+    if (atomic_load(&persistence.formatter_waiting)) {
+        pthread_mutex_lock(&persistence.lock);
+        pthread_cond_signal(&persistence.work);
+        pthread_mutex_unlock(&persistence.lock);
+    }
+}
+
+// Queues a committed trade; only waits if the ring is completely full
+void persistence_submit(const Transaction *t) {
+    if (!persistence.running) return;
+
+    uint64_t tail = atomic_load_explicit(&persistence.tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&persistence.head, memory_order_acquire) >= PERSIST_QUEUE_CAPACITY) {
+        persistence_wake_formatter();
+        sched_yield();
+    }
+    persistence.queue[tail & (PERSIST_QUEUE_CAPACITY - 1)] = *t;
+    atomic_store(&persistence.tail, tail + 1);
+    persistence_wake_formatter();
+}
+
+// Hands the front buffer to the writer once it has finished the back one
+void persistence_hand_off() {
+    pthread_mutex_lock(&persistence.lock);
+    while (persistence.back_full) {
+        pthread_cond_wait(&persistence.progress, &persistence.lock);
+    }
+    persistence.front = 1 - persistence.front;
+    persistence.back_full = true;
+    pthread_cond_signal(&persistence.writer_work);
+    pthread_mutex_unlock(&persistence.lock);
+}
+
+void *persistence_formatter_main(void *arg) {
+    (void)arg;
+    bool front_has_rows = false;    // A lone file prefix is not worth writing
+    for (;;) {
+        pthread_mutex_lock(&persistence.lock);
+        atomic_store(&persistence.formatter_waiting, true);
+        while (!persistence.stopping &&
+               atomic_load(&persistence.head) == atomic_load(&persistence.tail)) {
+            pthread_cond_wait(&persistence.work, &persistence.lock);
+        }
+        atomic_store(&persistence.formatter_waiting, false);
+        bool stopping = persistence.stopping;
+        pthread_mutex_unlock(&persistence.lock);
+
+        uint64_t head = atomic_load_explicit(&persistence.head, memory_order_relaxed);
+        uint64_t tail = atomic_load_explicit(&persistence.tail, memory_order_acquire);
+        while (head != tail) {
+            PersistBuffer *front = &persistence.buffers[persistence.front];
+            const Transaction *t = &persistence.queue[head & (PERSIST_QUEUE_CAPACITY - 1)];
+            front->length += format_transaction_row(front->data + front->length, t);
+            front_has_rows = true;
+            head++;
+            front->last_sequence = head;
+            atomic_store_explicit(&persistence.head, head, memory_order_release);
+
+            if (PERSIST_BUFFER_BYTES - front->length < PERSIST_MAX_ROW_BYTES) {
+                persistence_hand_off();
+                front_has_rows = false;
+            }
+            if (head == tail) {
+                tail = atomic_load_explicit(&persistence.tail, memory_order_acquire);
+            }
+        }
+
+        // Queue drained: write out what we have rather than waiting to fill
+        if (front_has_rows) {
+            persistence_hand_off();
+            front_has_rows = false;
+        }
+        if (stopping && atomic_load(&persistence.head) == atomic_load(&persistence.tail)) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&persistence.lock);
+    persistence.writer_stopping = true;
+    pthread_cond_signal(&persistence.writer_work);
+    pthread_mutex_unlock(&persistence.lock);
+    return NULL;
+}
+
+void *persistence_writer_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&persistence.lock);
+        while (!persistence.back_full && !persistence.writer_stopping) {
+            pthread_cond_wait(&persistence.writer_work, &persistence.lock);
+        }
+        if (!persistence.back_full) {
+            pthread_mutex_unlock(&persistence.lock);
+            break;
+        }
+        PersistBuffer *back = &persistence.buffers[1 - persistence.front];
+        pthread_mutex_unlock(&persistence.lock);
+
+        // After a failure nothing more is appended, so no row lands after a
+        // torn one; the buffers are still drained so the operator never blocks
+        int error = atomic_load(&persistence.error);
+        size_t written = 0;
+        while (error == 0 && written < back->length) {
+            ssize_t n = write(persistence.fd, back->data + written, back->length - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                error = errno;
+            } else if (n == 0) {
+                error = EIO;
+            } else {
+                written += (size_t)n;
+            }
+        }
+        if (error == 0 && fsync(persistence.fd) != 0) error = errno;
+        if (error != 0 && atomic_load(&persistence.error) == 0) {
+            fprintf(stderr, "Error: Could not append to %s: %s\n", TRANSACTIONS_FILE, strerror(error));
+            atomic_store(&persistence.error, error);
+        }
+
+        pthread_mutex_lock(&persistence.lock);
+        if (error == 0) persistence.durable = back->last_sequence;
+        back->length = 0;
+        persistence.back_full = false;
+        pthread_cond_broadcast(&persistence.progress);
+        pthread_mutex_unlock(&persistence.lock);
+    }
+    return NULL;
+}
+
+// Opens the transaction file for appending and starts the background
+// threads. `after_sellers` means the file currently ends in a "# Sellers"
+// section, so appended rows need a "# Transactions" marker first. Any such
+// prefix goes out together with the first trade.
+void persistence_start(bool after_sellers) {
+    persistence.fd = open(TRANSACTIONS_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (persistence.fd < 0) {
+        printf("Error: Could not open %s for appending\n", TRANSACTIONS_FILE);
+        return;
+    }
+
+    // May be a restart after a checkpoint; anything left unwritten was a lone prefix
+    persistence.front = 0;
+    persistence.back_full = false;
+    persistence.buffers[0].length = 0;
+    persistence.buffers[1].length = 0;
+    PersistBuffer *front = &persistence.buffers[0];
+    struct stat st;
+    if (fstat(persistence.fd, &st) == 0 && st.st_size == 0) {
+        front->length += snprintf(front->data, PERSIST_BUFFER_BYTES, "%s\n", TRANSACTIONS_HEADER);
+    } else {
+        // Older saves did not end the last row with a newline
+        char last = '\n';
+        int rfd = open(TRANSACTIONS_FILE, O_RDONLY);
+        if (rfd >= 0) {
+            if (pread(rfd, &last, 1, st.st_size - 1) != 1) last = '\n';
+            close(rfd);
+        }
+        if (last != '\n') front->data[front->length++] = '\n';
+        if (after_sellers) {
+            front->length += snprintf(front->data + front->length,
+                                      PERSIST_BUFFER_BYTES - front->length, "# Transactions\n");
+        }
+    }
+
+    persistence.stopping = false;
+    persistence.writer_stopping = false;
+    atomic_store(&persistence.error, 0);
+    pthread_mutex_init(&persistence.lock, NULL);
+    pthread_cond_init(&persistence.work, NULL);
+    pthread_cond_init(&persistence.writer_work, NULL);
+    pthread_cond_init(&persistence.progress, NULL);
+    persistence.running = true;
+    pthread_create(&persistence.writer, NULL, persistence_writer_main, NULL);
+    pthread_create(&persistence.formatter, NULL, persistence_formatter_main, NULL);
+}
+
+// Durability barrier: waits until every trade submitted so far is on disk.
+// Returns false if the journal could not be written, in which case some of
+// those trades are not.
+bool persistence_flush() {
+    if (!persistence.running) return atomic_load(&persistence.error) == 0;
+
+    uint64_t target = atomic_load(&persistence.tail);
+    pthread_mutex_lock(&persistence.lock);
+    pthread_cond_signal(&persistence.work);
+    while (persistence.durable < target && atomic_load(&persistence.error) == 0) {
+        pthread_cond_wait(&persistence.progress, &persistence.lock);
+    }
+    bool ok = persistence.durable >= target;
+    pthread_mutex_unlock(&persistence.lock);
+    return ok;
+}
+
+void report_persistence_error() {
+    printf("Error: Writing %s failed (%s); trades since the last save are not on disk.\n",
+           TRANSACTIONS_FILE, strerror(atomic_load(&persistence.error)));
+}
+
+// Drains the queue, stops both threads and closes the file
+void persistence_stop() {
+    if (!persistence.running) return;
+
+    pthread_mutex_lock(&persistence.lock);
+    persistence.stopping = true;
+    pthread_cond_signal(&persistence.work);
+    pthread_mutex_unlock(&persistence.lock);
+
+    pthread_join(persistence.formatter, NULL);
+    pthread_join(persistence.writer, NULL);
+    close(persistence.fd);
+    pthread_mutex_destroy(&persistence.lock);
+    pthread_cond_destroy(&persistence.work);
+    pthread_cond_destroy(&persistence.writer_work);
+    pthread_cond_destroy(&persistence.progress);
+    persistence.running = false;
+}
+
+// Checkpoints the engine: CHECKPOINT_FILE is atomically replaced by a
+// snapshot covering the journal as it stands. Seller rates and regular-buyer
+// flags live only in the checkpoint; the journal itself is never rewritten.
+// The persistence threads are stopped meanwhile so the journal holds still.
+void save_transactions_to_file() {
+    // A checkpoint must not cover trades the journal failed to record
+    if (!persistence_flush()) {
+        report_persistence_error();
+        return;
+    }
+    bool was_running = persistence.running;
+    persistence_stop();
+
+    int fd = open(TRANSACTIONS_FILE, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("Error: Could not open %s\n", TRANSACTIONS_FILE);
+        if (fd >= 0) close(fd);
+        if (was_running) persistence_start(file_ends_in_sellers);
+        return;
+    }
+
+    // Count the lines appended since the last known point, so messages
+    // after a restart still carry real line numbers. A last row without a
+    // newline is not a full line yet.
+    int64_t lines = journal_known_lines;
+    char chunk[64 * 1024];
+    for (int64_t offset = journal_known_bytes; offset < st.st_size; ) {
+        ssize_t n = pread(fd, chunk, sizeof(chunk), offset);
+        if (n <= 0) break;
+        for (ssize_t i = 0; i < n; i++) {
+            if (chunk[i] == '\n') lines++;
+        }
+        offset += n;
+    }
+
+    // Rows appended since the last known point start with "# Transactions"
+    // when needed, so the journal only stays in a seller section if nothing
+    // was appended
+    bool in_sellers = file_ends_in_sellers && st.st_size == journal_known_bytes;
+
+    uint8_t tail[CHECKPOINT_TAIL_BYTES];
+    uint32_t tail_length = st.st_size < CHECKPOINT_TAIL_BYTES ? (uint32_t)st.st_size : CHECKPOINT_TAIL_BYTES;
+    bool ok = pread(fd, tail, tail_length, st.st_size - tail_length) == (ssize_t)tail_length;
+    close(fd);
+
+    if (ok) ok = write_checkpoint(st.st_size, lines, in_sellers, tail, tail_length);
+    if (ok) {
+        journal_known_bytes = st.st_size;
+        journal_known_lines = lines;
+        file_ends_in_sellers = in_sellers;
+        trades_since_checkpoint = 0;
+    } else {
+        printf("Error: Could not save checkpoint %s\n", CHECKPOINT_FILE);
+    }
+    if (was_running) persistence_start(file_ends_in_sellers);
+}
+
+// ---------------------------- Main Menu ----------------------------
+
+int main(int argc, char *argv[]) {
+    // Initialize global trees
+    global_transaction_tree = NULL;
+    transaction_index = 0;
+
+    // A replica runs reports against the state a writer started with
+    // --publish, in the same directory, has published
+    bool replica = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0 || strcmp(argv[i], "--bench-save") == 0) {
+            // Tree micro-benchmarks run standalone, without loading any data
+            return run_benchmarks(strcmp(argv[i], "--bench-save") == 0) ? 0 : 1;
+        } else if (strcmp(argv[i], "--replica") == 0) {
+            replica = true;
+        } else if (strcmp(argv[i], "--publish") == 0) {
+            replica_publishing = true;
+        } else if (strcmp(argv[i], "--no-tiering") == 0) {
+            tiered_storage = false;
+        } else {
+            printf("Usage: %s [--publish | --replica] [--no-tiering]\n", argv[0]);
+            printf("       %s --bench | --bench-save\n", argv[0]);
+            return 1;
+        }
+    }
+    if (replica && replica_publishing) {
+        printf("Error: --replica and --publish cannot be combined.\n");
+        return 1;
+    }
+    replica_name_init();
+    if (replica) {
+        if (!replica_refresh()) {
+            printf("Error: No published snapshot to attach to; start the main process with --publish first.\n");
+            return 1;
+        }
+        printf("Attached to published snapshot version %llu (read-only).\n",
+               (unsigned long long)replica_generation);
+    } else {
+        // Load existing data
+        load_transactions_from_file();
+        persistence_start(file_ends_in_sellers);
+        if (journal_replayed_trades >= CHECKPOINT_INTERVAL) {
+            checkpoint_start(-1);
+        }
+        replica_publish_start();
+    }
+
+    int choice;
+    do {
+        printf("\n==== Energy Trading Record Management System ====\n");
+        printf("1. Add New Transaction\n");
+        printf("2. Display All Transactions\n");
+        printf("3. Transactions for Every Seller\n");
+        printf("4. Transactions for Every Buyer\n");
+        printf("5. Total Revenue by Seller\n");
+        printf("6. Transactions in Energy Range\n");
+        printf("7. Sort Buyers by Energy Bought\n");
+        printf("8. Sort Buyer/Seller Pairs\n");
+        printf("9. Transactions in Time Range\n");
+        printf("10. Report Cache Statistics\n");
+        printf("11. Export Transactions\n");
+        printf("12. Seller Transactions in Time Range\n");
+        printf("13. Buyer Transactions in Time Range\n");
+        printf("14. Publish Snapshot for Read Replicas\n");
+        printf("15. Top Traders (Streaming Estimate)\n");
+        printf("16. Approximate Pair Transaction Count\n");
+        printf("0. Exit\n");
+        printf("Choice: ");
+        scanf("%d", &choice);
+
+        // Pick up the newest published version before each report
+        if (replica) replica_refresh();
+
+        switch(choice) {
+            case 1: {
+                if (replica) {
+                    printf("Read-only replica: add transactions in the main process.\n");
+                    break;
+                }
+                printf("\nEnter Transaction Details:\n");
+                int transaction_id, buyer_id, seller_id;
+                double energy_input, rate_input;
+                energy_t energy_kwh;
+                money_t rate_below_300, rate_above_300;
+                char datetime[20];
+                
+                printf("Transaction ID: ");
+                scanf("%d", &transaction_id);
+                printf("Buyer ID: ");
+                scanf("%d", &buyer_id);
+                printf("Seller ID: ");
+                scanf("%d", &seller_id);
+                printf("Energy (kWh): ");
+                scanf("%lf", &energy_input);
+                energy_kwh = fixed_from_double(energy_input, ENERGY_SCALE);
+                
+                // Check if seller exists to get existing rates
+                SellerKey *existing_seller = find_seller(seller_id);
+                
+                if (existing_seller) {
+                    rate_below_300 = existing_seller->rate_below_300;
+                    rate_above_300 = existing_seller->rate_above_300;
+                    char below[32], above[32];
+                    printf("Using existing rates for Seller %d: %s$/kWh (≤300kWh), %s$/kWh (>300kWh)\n", 
+                           seller_id, format_money(below, rate_below_300), format_money(above, rate_above_300));
+                } else {
+                    printf("Enter rate for energy <= 300 kWh ($/kWh): ");
+                    scanf("%lf", &rate_input);
+                    rate_below_300 = fixed_from_double(rate_input, MONEY_SCALE);
+                    printf("Enter rate for energy > 300 kWh ($/kWh): ");
+                    scanf("%lf", &rate_input);
+                    rate_above_300 = fixed_from_double(rate_input, MONEY_SCALE);
+                }
+                
+                printf("Enter date and time (YYYY-MM-DD HH:MM): ");
+                scanf(" %19[^\n]", datetime);
+                while(!validate_datetime(datetime)) {
+                    printf("Invalid datetime format.\n");
+                    printf("Enter date and time (YYYY-MM-DD HH:MM): ");
+                    scanf(" %19[^\n]", datetime);
+                    
+                }
+                
+                Transaction *t = (Transaction *)malloc(sizeof(Transaction));
+                t->transaction_id = transaction_id;
+                t->buyer_id = buyer_id;
+                t->seller_id = seller_id;
+                t->energy_kwh = energy_kwh;
+                strncpy(t->datetime, datetime, sizeof(t->datetime));
+                t->rate_below_300 = rate_below_300;
+                t->rate_above_300 = rate_above_300;
+                
+                SellerKey *s = get_or_create_seller(seller_id, rate_below_300, rate_above_300);
+                
+                price_transaction(t, s);
+                
+                // add_transaction() may seal and free `t`, so queue a copy
+                Transaction committed = *t;
+                if (add_transaction(t)) {
+                    persistence_submit(&committed);
+                    printf("Transaction added successfully!\n");
+                    if (atomic_load(&persistence.error) != 0) report_persistence_error();
+                    checkpoint_poll(false);
+                    if (trades_since_checkpoint >= checkpoint_due) {
+                        checkpoint_start(committed.transaction_id);
+                    }
+                    if (replica_publishing) {
+                        replica_publish_poll(false);
+                        if (++trades_since_publish >= REPLICA_PUBLISH_INTERVAL) replica_publish_start();
+                    }
+                }
+                break;
+            
+            case 2:
+                display_all_transactions();
+                break;
+            case 3:
+                transactions_by_seller();
+                break;
+            case 4:
+                transactions_by_buyer();
+                break;
+            case 5:
+                total_revenue_by_seller();
+                break;
+            case 6: {
+                double min, max;
+                printf("\nEnter min energy (kWh): ");
+                scanf("%lf", &min);
+                printf("Enter max energy (kWh): ");
+                scanf("%lf", &max);
+                energy_range_transactions(fixed_from_double(min, ENERGY_SCALE),
+                                          fixed_from_double(max, ENERGY_SCALE));
+                break;
+            }
+            case 7:
+                sort_buyers_by_energy();
+                break;
+            case 8:
+                sort_pairs_by_transaction_count();
+                break;
+            case 9: {
+                char start_str[20], end_str[20];
+                bool isvalid = false;
+                while(!isvalid) {
+                    printf("Enter start time (YYYY-MM-DD HH:MM): ");
+                    scanf(" %19[^\n]", start_str);
+                    printf("Enter end time (YYYY-MM-DD HH:MM): ");
+                    scanf(" %19[^\n]", end_str);
+                    if (!validate_datetime(start_str) || !validate_datetime(end_str)) {
+                        printf("Invalid datetime format. Try again.\n");
+                    }
+                    else isvalid = true;
+                } 
+                transactions_in_time_range(start_str, end_str);
+                break;
+            }
+            case 10:
+                print_report_cache_stats();
+                break;
+            case 11: {
+                int format_choice;
+                char path[256];
+                printf("Format (1. CSV, 2. JSON lines, 3. Binary): ");
+                scanf("%d", &format_choice);
+                if (format_choice < 1 || format_choice > 3) {
+                    printf("Invalid format.\n");
+                    break;
+                }
+                printf("Output file: ");
+                scanf(" %255[^\n]", path);
+                export_transactions(path, (ReportFormat)(format_choice - 1));
+                break;
+            }
+            case 12:
+            case 13: {
+                int participant_id;
+                char start_str[20], end_str[20];
+                printf(choice == 12 ? "Seller ID: " : "Buyer ID: ");
+                scanf("%d", &participant_id);
+                bool isvalid = false;
+                while(!isvalid) {
+                    printf("Enter start time (YYYY-MM-DD HH:MM): ");
+                    scanf(" %19[^\n]", start_str);
+                    printf("Enter end time (YYYY-MM-DD HH:MM): ");
+                    scanf(" %19[^\n]", end_str);
+                    if (!validate_datetime(start_str) || !validate_datetime(end_str)) {
+                        printf("Invalid datetime format. Try again.\n");
+                    }
+                    else isvalid = true;
+                }
+                if (choice == 12) seller_transactions_in_time_range(participant_id, start_str, end_str);
+                else buyer_transactions_in_time_range(participant_id, start_str, end_str);
+                break;
+            }
+            case 14:
+                if (replica) {
+                    printf("Read-only replica: publish from the main process.\n");
+                    break;
+                }
+                if (!replica_publishing) {
+                    printf("Publishing is off; start with --publish to serve read replicas.\n");
+                    break;
+                }
+                // Let a running publish finish so this one sees every trade
+                replica_publish_poll(true);
+                replica_publish_start();
+                replica_publish_poll(true);
+                printf("Published snapshot version %llu.\n", (unsigned long long)replica_generation);
+                break;
+            case 15:
+                sketch_top_traders();
+                break;
+            case 16: {
+                int buyer_id, seller_id;
+                printf("Buyer ID: ");
+                scanf("%d", &buyer_id);
+                printf("Seller ID: ");
+                scanf("%d", &seller_id);
+                sketch_pair_count(buyer_id, seller_id);
+                break;
+            }
+            case 0:
+                if (replica) {
+                    replica_release();
+                    printf("Exiting...\n");
+                    break;
+                }
+                // A background checkpoint still needs the journal writer
+                checkpoint_poll(true);
+                if (!persistence_flush()) {
+                    persistence_stop();
+                    report_persistence_error();
+                } else {
+                    persistence_stop();
+                    if (trades_since_checkpoint > 0) {
+                        save_transactions_to_file();
+                        printf("All transactions saved.\n");
+                    }
+                }
+                replica_publish_poll(true);
+                replica_withdraw();
+                printf("Exiting...\n");
+                break;
+            default:
+                printf("Invalid choice. Please try again.\n");
+        }
+    }} while (choice != 0);
+
+    
+
+    return 0;
+}
+
+
     
\ No newline at end of file